@@ -1,113 +1,185 @@
 #pragma once
 
+#include "checkpoint.hpp"
+#include "query.hpp"
+#include "snapshot.hpp"
+#include "soa.hpp"
+#include "storage.hpp"
 #include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <tuple>
+#include <utility>
 #include <vector>
 #include <cassert>
 
 
 namespace gxe {
 
-// Archetypes are templated over components
-template<typename ...AComponents>
-class archetype {
+// Shared archetype implementation over a storage policy (see storage.hpp).
+// Use through archetype<...> below.
+template<typename Storage, typename ...AComponents>
+class archetype_base {
+public:
     static constexpr size_t N_COMPONENTS = sizeof...(AComponents);
 
-public:
-    archetype(size_t reserveSize = 128) {
-        std::apply([reserveSize](auto&... vecs) {
-            (vecs.reserve(reserveSize), ...);
-        }, _components);
-        _entityIds.reserve(reserveSize);
-    }
+    using componentTuple = std::tuple<AComponents...>;
+    using columnSpans = std::tuple<std::span<const AComponents>...>; // Bulk insert source
+    using storageType = Storage;
 
-    ~archetype() = default;
+    // What getComponentAt<T> returns: T&, or soaRef<T> for soa<T> columns.
+    template<typename T>
+    using componentRef = decltype(std::declval<Storage&>().template get<T>(0));
+
+    // Rows per contiguous block: a chunk for chunked storage, unbounded otherwise.
+    // An entity's archetype-local id maps to chunk localId / ROWS_PER_BLOCK,
+    // row localId % ROWS_PER_BLOCK.
+    static constexpr size_t ROWS_PER_BLOCK = Storage::ROWS_PER_BLOCK;
+
+    // Rows sharing a change tick per column: a chunk, or CHANGE_BLOCK_ROWS.
+    static constexpr size_t TRACK_ROWS =
+        ROWS_PER_BLOCK != std::numeric_limits<size_t>::max() ? ROWS_PER_BLOCK : CHANGE_BLOCK_ROWS;
 
-    // Set the owner ECS (must be called before using entity operations)
-    void setWorld(ecs_base* world) {
-        _world = world;
+    // Columns, ids and change ticks are allocated from resource.
+    explicit archetype_base(size_t reserveSize = INITIAL_ARCHETYPE_CAPACITY,
+                            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _storage(reserveSize, resource)
+        , _rowVersions(resource) {
+        for (auto& ticks : _addedTicks) {
+            ticks = columnVector<uint32_t>(resource);
+            ticks.reserve(reserveSize);
+        }
+        for (auto& ticks : _changedTicks) {
+            ticks = columnVector<uint32_t>(resource);
+        }
     }
 
+    archetype_base(archetype_base&&) noexcept = default;
+    archetype_base& operator=(archetype_base&&) noexcept = default;
+    ~archetype_base() = default;
+
     // Add entity with components, returns archetypeID (index in this archetype)
-    archetypeid addEntity(entityid id, const AComponents&... components) {
-        archetypeid archId = static_cast<archetypeid>(_entityIds.size());
-        
-        _entityIds.push_back(id);
-        
-        std::apply([&](auto&... vecs) {
-            (vecs.push_back(components), ...);
-        }, _components);
-        
-        return archId;
-    }
-
-    // Remove entity by entityid (performs swap-and-pop)
-    void removeEntity(entityid id) {
-        assert(_world && "Archetype owner not set");
-        
-        archetypeid archId = _world->getArchetypeLocalId(id);
-        if (archId == NULL_ARCHETYPE_ID) {
-            return;
+    // Components are passed in archetype order.
+    template<typename ...Args>
+    archetypeid addEntity(entityid id, Args&&... components) {
+        static_assert(sizeof...(Args) == N_COMPONENTS, "One argument per archetype component");
+        archetypeid row = _storage.push(id, std::forward<Args>(components)...);
+        for (auto& ticks : _addedTicks) {
+            ticks.push_back(0);
+        }
+        if (row % TRACK_ROWS == 0) {
+            growTicks();
         }
+        touchRows(row, row + 1);
+        return row;
+    }
+
+    // Append ids.size() entities from one span per column, returns the first row.
+    archetypeid addEntities(std::span<const entityid> ids, const columnSpans& columns) {
+        [[maybe_unused]] bool lengthsMatch = std::apply([&](const auto&... spans) {
+            return ((spans.size() == ids.size()) && ...);
+        }, columns);
+        assert(lengthsMatch && "Column length mismatch");
+
+        archetypeid first = std::apply([&](const auto&... spans) {
+            return _storage.append(ids, spans...);
+        }, columns);
+        growTicks();
+        touchRows(first, first + ids.size());
+        return first;
+    }
+
+    // Append ids.size() entities and fill them in place with
+    // generator(i, AComponents&...) for i in [0, ids.size()). Returns the first row.
+    template<typename Generator>
+    archetypeid addEntities(std::span<const entityid> ids, Generator&& generator) {
+        archetypeid first = _storage.appendDefault(ids);
+        growTicks();
+        touchRows(first, first + ids.size());
+        _storage.template forEachBlock<AComponents...>(first, first + ids.size(),
+            [&, i = size_t(0)](const entityid*, size_t count, auto... columns) mutable {
+                for (size_t k = 0; k < count; ++k, ++i) {
+                    invokeRow([&](auto&... components) { generator(i, components...); }, columns[k]...);
+                }
+            });
+        return first;
+    }
 
-        archetypeid lastArchId = static_cast<archetypeid>(_entityIds.size() - 1);
+    // Remove the entity at row (performs swap-and-pop).
+    // Returns the entity that was moved into row, or NULL_ID if row was the
+    // last one; the owner must update that entity's record.
+    entityid removeRow(archetypeid row) {
+        assert(row < _storage.size() && "Invalid archetype ID");
+
+        archetypeid lastArchId = static_cast<archetypeid>(_storage.size() - 1);
+        entityid moved = NULL_ID;
 
         // Swap with last element
-        if (archId != lastArchId) {
-            entityid lastEntityId = _entityIds[lastArchId];
-            
-            // Swap entity IDs
-            _entityIds[archId] = lastEntityId;
-            
-            // Swap components in each vector
-            std::apply([archId, lastArchId](auto&... vecs) {
-                ((vecs[archId] = std::move(vecs[lastArchId])), ...);
-            }, _components);
-            
-            // Update mapping for swapped entity in the owner ECS
-            _world->setArchetypeLocalId(lastEntityId, archId);
+        if (row != lastArchId) {
+            _storage.moveRow(row, lastArchId);
+            moveTicks(row, lastArchId);
+            moved = _storage.entityAt(row);
         }
+        touchRows(row, row + 1);
+        touchRows(lastArchId, lastArchId + 1);
 
         // Remove last elements
-        _entityIds.pop_back();
-        std::apply([](auto&... vecs) {
-            (vecs.pop_back(), ...);
-        }, _components);
+        _storage.truncate(lastArchId);
+        truncateTicks(lastArchId);
+        return moved;
     }
 
-    // Get component for entity
-    template<typename T>
-    T& getComponent(entityid id) {
-        static_assert((std::is_same_v<T, AComponents> || ...), "Component type not in archetype");
-        assert(_world && "Archetype owner not set");
-        
-        archetypeid archId = _world->getArchetypeLocalId(id);
-        assert(archId != NULL_ARCHETYPE_ID && "Entity not in archetype");
-        
-        return std::get<std::vector<T>>(_components)[archId];
+    // Remove several rows in one compaction pass.
+    // rows must be unique and sorted in descending order; each hole is filled
+    // from the tail and the columns are truncated once at the end.
+    // onMoved(entityid, archetypeid newRow) is called for every relocated entity.
+    template<typename OnMoved>
+    void removeRows(std::span<const archetypeid> rows, OnMoved&& onMoved) {
+        if (rows.empty()) {
+            return;
+        }
+
+        size_t end = _storage.size();
+        for (archetypeid row : rows) {
+            assert(row < end && "Rows must be unique and descending");
+            --end;
+            if (row != end) {
+                _storage.moveRow(row, end);
+                moveTicks(row, end);
+                onMoved(_storage.entityAt(row), row);
+            }
+            touchRows(row, row + 1);
+            touchRows(end, end + 1);
+        }
+
+        _storage.truncate(end);
+        truncateTicks(end);
     }
 
+    // Get component at an archetype-local row (resolved by the owner from the entity record)
     template<typename T>
-    const T& getComponent(entityid id) const {
-        static_assert((std::is_same_v<T, AComponents> || ...), "Component type not in archetype");
-        assert(_world && "Archetype owner not set");
-        
-        archetypeid archId = _world->getArchetypeLocalId(id);
-        assert(archId != NULL_ARCHETYPE_ID && "Entity not in archetype");
-        
-        return std::get<std::vector<T>>(_components)[archId];
+    componentRef<T> getComponentAt(archetypeid row) {
+        static_assert(hasComponent<T>(), "Component type not in archetype");
+        assert(row < _storage.size() && "Invalid archetype ID");
+        return _storage.template get<T>(row);
     }
 
-    // Check if entity exists in this archetype
-    bool hasEntity(entityid id) const {
-        if (!_world) return false;
-        archetypeid archId = _world->getArchetypeLocalId(id);
-        return archId != NULL_ARCHETYPE_ID && archId < _entityIds.size();
+    template<typename T>
+    decltype(auto) getComponentAt(archetypeid row) const {
+        static_assert(hasComponent<T>(), "Component type not in archetype");
+        assert(row < _storage.size() && "Invalid archetype ID");
+        return _storage.template get<T>(row);
     }
 
+    // C may be a query term: const T, changed<T> or added<T>.
     template<typename C>
     static constexpr bool hasComponent(){
-        return (std::is_same_v<C, AComponents> || ...);
+        return (std::is_same_v<termComponent_t<C>, AComponents> || ...);
     }
 
     template<typename... C>
@@ -115,71 +187,479 @@ public:
         return (hasComponent<C>() && ...);
     }
 
-    // Get archetypeID for entity
-    archetypeid getArchetypeId(entityid id) const {
-        assert(_world && "Archetype owner not set");
-        archetypeid archId = _world->getArchetypeLocalId(id);
-        assert(archId != NULL_ARCHETYPE_ID && "Entity not in archetype");
-        return archId;
-    }
-
     // Get entityID at archetype index
     entityid getEntityId(archetypeid archId) const {
-        assert(archId < _entityIds.size() && "Invalid archetype ID");
-        return _entityIds[archId];
+        assert(archId < _storage.size() && "Invalid archetype ID");
+        return _storage.entityAt(archId);
     }
 
-    // Iterate over all entities in archetype (all components)
+    // Iterate over all entities in archetype (all components).
+    // Every column counts as written: blocks are stamped with window.tick.
     template<typename Func>
-    void forEach(Func&& func) {
-        size_t count = _entityIds.size();
+    void forEach(Func&& func, const changeWindow& window = {}) {
+        stampRange<AComponents...>(0, _storage.size(), window.tick);
+        _storage.template forEachBlock<AComponents...>(0, _storage.size(),
+            [&](const entityid* ids, size_t count, auto... columns) {
+                for (size_t i = 0; i < count; ++i) {
+                    invokeRow([&](auto&... components) { func(ids[i], components...); }, columns[i]...);
+                }
+            });
+    }
+
+    // Iterate over all entities with specific components only.
+    // Terms may be const T (read only), changed<T> or added<T> (see query.hpp).
+    template<typename... Terms, typename Func>
+    void forEachWith(Func&& func, const changeWindow& window = {}) {
+        forEachWithRange<Terms...>(0, _storage.size(), std::forward<Func>(func), window);
+    }
+
+    // Iterate over rows [begin, end) with specific components only.
+    // Disjoint ranges may be processed concurrently if they start on
+    // alignedGrain() boundaries.
+    template<typename... Terms, typename Func>
+    void forEachWithRange(size_t begin, size_t end, Func&& func, const changeWindow& window = {}) {
+        assert(begin <= end && end <= _storage.size() && "Invalid row range");
+        forEachRows(queryComponents<Terms...>{}, queryFilters<Terms...>{}, begin, end, func, window);
+    }
+
+    // Iterate over contiguous blocks (a chunk, or the whole archetype for vector
+    // storage), handing every requested column over as a span:
+    //   func(std::span<Requested>..., std::span<const entityid>) or func(std::span<Requested>...)
+    // soa<T> columns arrive as soaSpan<T> (one span per field) instead.
+    // Spans start COLUMN_ALIGNMENT aligned, which lets batch kernels vectorize.
+    // changed<T> filters skip unchanged blocks (spans then cover TRACK_ROWS rows).
+    template<typename... Terms, typename Func>
+    void forEachChunk(Func&& func, const changeWindow& window = {}) {
+        forEachChunkRange<Terms...>(0, _storage.size(), std::forward<Func>(func), window);
+    }
+
+    // forEachChunk restricted to rows [begin, end). Spans are only aligned when
+    // begin is a multiple of alignedGrain().
+    template<typename... Terms, typename Func>
+    void forEachChunkRange(size_t begin, size_t end, Func&& func, const changeWindow& window = {}) {
+        assert(begin <= end && end <= _storage.size() && "Invalid row range");
+        forEachSpans(queryComponents<Terms...>{}, queryFilters<Terms...>{}, begin, end, func, window);
+    }
+
+    // Round a row grain so ranges start on aligned block boundaries that also
+    // own their change ticks: whole chunks for chunked storage, multiples of
+    // CHANGE_BLOCK_ROWS otherwise.
+    static constexpr size_t alignedGrain(size_t grain) {
+        return grain <= TRACK_ROWS ? TRACK_ROWS : (grain + TRACK_ROWS - 1) / TRACK_ROWS * TRACK_ROWS;
+    }
+
+    // Change tracking, driven by the owning ecs.
+    // Stamp rows [first, first + count) as added and changed at tick.
+    void markAdded(archetypeid first, size_t count, uint32_t tick) {
+        for (auto& ticks : _addedTicks) {
+            std::fill_n(ticks.begin() + first, count, tick);
+        }
+        stampRange<AComponents...>(first, first + count, tick);
+    }
+
+    // Safe to call concurrently for rows of one block (e.g. getComponent from
+    // parallel callbacks): the block's tick only ever moves forward.
+    template<typename T>
+    void markChanged(archetypeid row, uint32_t tick) {
+        stampRange<T>(row, row + 1, tick);
+    }
+
+    template<typename T>
+    uint32_t addedTick(archetypeid row) const {
+        return _addedTicks[columnIndex<T>()][row];
+    }
+
+    template<typename T>
+    void setAddedTick(archetypeid row, uint32_t tick) {
+        _addedTicks[columnIndex<T>()][row] = tick;
+    }
+
+    // Last write to T in the tracking block holding row.
+    template<typename T>
+    uint32_t changedTick(archetypeid row) const {
+        return loadTick(_changedTicks[columnIndex<T>()][row / TRACK_ROWS]);
+    }
+
+    size_t size() const {
+        return _storage.size();
+    }
+
+    void clear() {
+        touchRows(0, _storage.size());
+        _storage.truncate(0);
+        truncateTicks(0);
+    }
+
+    // Copy-on-write checkpoint (see checkpoint.hpp). Blocks whose rows did not
+    // move and whose column was not written since `previous` (captured at
+    // change tick previousTick) share its buffers; the rest are copied into
+    // buffers from out's resource.
+    void captureCheckpoint(archetypeCheckpoint& out, const archetypeCheckpoint* previous, uint32_t previousTick) {
+        static_assert((std::is_trivially_copyable_v<AComponents> && ...),
+                      "Checkpoints require trivially copyable components");
+        size_t rows = _storage.size();
+        size_t blocks = (rows + TRACK_ROWS - 1) / TRACK_ROWS;
+        size_t previousBlocks = previous ? previous->blocks.size() / CHECKPOINT_COLUMNS : 0;
+        out.rows = rows;
+        out.version = _rowVersion++;
+        out.blocks.resize(blocks * CHECKPOINT_COLUMNS);
+        std::pmr::memory_resource* resource = out.resource();
+
+        for (size_t block = 0; block < blocks; ++block) {
+            size_t begin = block * TRACK_ROWS;
+            bool moved = block >= previousBlocks || _rowVersions[block] > previous->version;
+            checkpointBuffer* dst = out.blocks.data() + block * CHECKPOINT_COLUMNS;
+            const checkpointBuffer* src = moved ? nullptr : previous->blocks.data() + block * CHECKPOINT_COLUMNS;
+
+            _storage.template forEachBlock<const AComponents...>(begin, std::min(begin + TRACK_ROWS, rows),
+                [&](const entityid* ids, size_t count, auto... columns) {
+                    dst[0] = moved ? copyToBuffer(ids, count * sizeof(entityid), resource) : src[0];
+                    [&]<size_t... I>(std::index_sequence<I...>) {
+                        ((dst[I + 1] = moved || _changedTicks[I][block] > previousTick
+                            ? copyColumn(columns, count, resource) : src[I + 1]), ...);
+                    }(std::index_sequence_for<AComponents...>{});
+                });
+        }
+    }
+
+    // Roll the rows back to a checkpoint captured at checkpointTick. Blocks
+    // whose rows moved since are rewritten whole and placed(id, row) is called
+    // for every row in them; elsewhere only columns written since are copied.
+    // Everything restored is stamped changed at tick.
+    template<typename Placed>
+    void restoreCheckpoint(const archetypeCheckpoint& checkpoint, uint32_t checkpointTick, uint32_t tick, Placed&& placed) {
+        size_t rows = _storage.size();
+        if (rows > checkpoint.rows) {
+            touchRows(checkpoint.rows, rows);
+            _storage.truncate(checkpoint.rows);
+            truncateTicks(checkpoint.rows);
+        } else if (rows < checkpoint.rows) {
+            // Re-append the missing rows under their checkpointed ids; the
+            // block copies below fill in the components.
+            for (size_t row = rows; row < checkpoint.rows;) {
+                size_t slot = row % TRACK_ROWS;
+                size_t count = std::min(TRACK_ROWS - slot, checkpoint.rows - row);
+                const auto* ids = reinterpret_cast<const entityid*>(
+                    checkpoint.blocks[row / TRACK_ROWS * CHECKPOINT_COLUMNS].get()) + slot;
+                _storage.appendDefault(std::span<const entityid>(ids, count));
+                row += count;
+            }
+            growTicks();
+            touchRows(rows, checkpoint.rows);
+            markAdded(static_cast<archetypeid>(rows), checkpoint.rows - rows, tick);
+        }
+
+        size_t blocks = (checkpoint.rows + TRACK_ROWS - 1) / TRACK_ROWS;
+        for (size_t block = 0; block < blocks; ++block) {
+            size_t begin = block * TRACK_ROWS;
+            bool moved = _rowVersions[block] > checkpoint.version;
+            const checkpointBuffer* src = checkpoint.blocks.data() + block * CHECKPOINT_COLUMNS;
+
+            _storage.template forEachBlock<AComponents...>(begin, std::min(begin + TRACK_ROWS, checkpoint.rows),
+                [&](entityid* ids, size_t count, auto... columns) {
+                    if (moved) {
+                        std::memcpy(ids, src[0].get(), count * sizeof(entityid));
+                        for (size_t i = 0; i < count; ++i) {
+                            placed(ids[i], static_cast<archetypeid>(begin + i));
+                        }
+                    }
+                    [&]<size_t... I>(std::index_sequence<I...>) {
+                        ([&] {
+                            if (moved || _changedTicks[I][block] > checkpointTick) {
+                                restoreColumn(columns, src[I + 1], count);
+                                _changedTicks[I][block] = tick;
+                            }
+                        }(), ...);
+                    }(std::index_sequence_for<AComponents...>{});
+                });
+            if (moved) {
+                _rowVersions[block] = _rowVersion;
+            }
+        }
+    }
+
+    // Snapshot: row count, entity ids, then one aligned T[rows] array per
+    // component (soa<T> rows are gathered back into T).
+    void saveSnapshot(snapshotWriter& out) {
+        static_assert((std::is_trivially_copyable_v<AComponents> && ...),
+                      "Snapshots require trivially copyable components");
+        size_t rows = _storage.size();
+        out.value(static_cast<uint64_t>(rows));
+        out.align();
+        _storage.template forEachBlock<>(0, rows, [&](const entityid* ids, size_t count) {
+            out.write(ids, count * sizeof(entityid));
+        });
+        (saveColumn<AComponents>(out), ...);
+    }
+
+    // Upper bound of the bytes saveSnapshot writes.
+    size_t snapshotBytes() const {
+        return (N_COMPONENTS + 2) * SNAPSHOT_ALIGNMENT + _storage.size() * (sizeof(entityid) + ... + sizeof(AComponents));
+    }
+
+    // Append the rows of a saveSnapshot block, copying each column straight
+    // from the reader's memory. False (nothing appended) on truncated data.
+    bool loadSnapshot(snapshotReader& in) {
+        uint64_t rows = 0;
+        if (!in.value(rows)) {
+            return false;
+        }
+        std::span<const entityid> ids = in.template array<entityid>(rows);
+        const columnSpans columns{in.template array<AComponents>(rows)...};
+        if (!in.ok()) {
+            return false;
+        }
+        addEntities(ids, columns);
+        return true;
+    }
+
+private:
+    template<typename T>
+    static constexpr size_t columnIndex() {
+        return typeIndex<termComponent_t<T>, AComponents...>();
+    }
+
+    static constexpr size_t CHECKPOINT_COLUMNS = N_COMPONENTS + 1; // + entity ids
+
+    // Rows in [begin, end) were added, removed or replaced by another row.
+    void touchRows(size_t begin, size_t end) {
+        for (size_t block = begin / TRACK_ROWS; block * TRACK_ROWS < end; ++block) {
+            _rowVersions[block] = _rowVersion;
+        }
+    }
+
+    template<typename T>
+    static checkpointBuffer copyColumn(const T* column, size_t count, std::pmr::memory_resource* resource) {
+        return copyToBuffer(column, count * sizeof(T), resource);
+    }
+
+    template<typename T>
+    static checkpointBuffer copyColumn(soaPtr<T> column, size_t count, std::pmr::memory_resource* resource) {
+        std::shared_ptr<std::byte[]> buffer = allocateBuffer(count * sizeof(T), resource);
         for (size_t i = 0; i < count; ++i) {
-            entityid id = _entityIds[i];
-            std::apply([&](auto&... vecs) {
-                func(id, vecs[i]...);
-            }, _components);
+            T value = column[i];
+            std::memcpy(buffer.get() + i * sizeof(T), &value, sizeof(T));
         }
+        return buffer;
     }
 
-    // Iterate over all entities with specific components only
-    template<typename... RequestedComponents, typename Func>
-    void forEachWith(Func&& func) {
-        static_assert(sizeof...(RequestedComponents) >= 0, "Must request at least one component");
-        
-        size_t count = _entityIds.size();
+    template<typename T>
+    static void restoreColumn(T* column, const checkpointBuffer& src, size_t count) {
+        std::memcpy(static_cast<void*>(column), src.get(), count * sizeof(T));
+    }
+
+    template<typename T>
+    static void restoreColumn(soaPtr<T> column, const checkpointBuffer& src, size_t count) {
         for (size_t i = 0; i < count; ++i) {
-            entityid id = _entityIds[i];
+            T value;
+            std::memcpy(static_cast<void*>(&value), src.get() + i * sizeof(T), sizeof(T));
+            column[i] = value;
+        }
+    }
 
-            if constexpr (std::is_invocable_v<Func, entityid, RequestedComponents&...>){
-                func(id, std::get<std::vector<RequestedComponents>>(_components)[i]...);
-            } else if constexpr (std::is_invocable_v<Func, RequestedComponents&...>){
-                func(std::get<std::vector<RequestedComponents>>(_components)[i]...);
+    template<typename T>
+    void saveColumn(snapshotWriter& out) {
+        out.align();
+        _storage.template forEachBlock<const T>(0, _storage.size(), [&](const entityid*, size_t count, auto column) {
+            if constexpr (std::is_pointer_v<decltype(column)>) {
+                out.write(column, count * sizeof(T));
             } else {
-                static_assert(std::is_invocable_v<Func, entityid, RequestedComponents&...> ||
-                         std::is_invocable_v<Func, RequestedComponents&...>,
-                         "Lambda must accept (entityid, Components&...) or (Components&...)");
+                // soa<T>: gather rows in small batches
+                std::array<T, 256> rows;
+                for (size_t i = 0; i < count; i += rows.size()) {
+                    size_t n = std::min(rows.size(), count - i);
+                    for (size_t k = 0; k < n; ++k) {
+                        rows[k] = column[i + k];
+                    }
+                    out.write(rows.data(), n * sizeof(T));
+                }
             }
+        });
+    }
+
+    template<typename... Requested, typename... Filters, typename Func>
+    void forEachRows(typeList<Requested...>, typeList<Filters...>, size_t begin, size_t end,
+                     Func& func, const changeWindow& window) {
+        static_assert(hasComponents<Requested..., Filters...>(), "Component type not in archetype");
+
+        // Visit rows [b, e), skipping rows rejected by the added<> filters.
+        auto rows = [&](size_t b, size_t e) {
+            _storage.template forEachBlock<Requested...>(b, e,
+                [&, row = b](const entityid* ids, size_t count, auto... columns) mutable {
+                    for (size_t i = 0; i < count; ++i, ++row) {
+                        if (!(rowPasses<Filters>(row, window.since) && ...)) {
+                            continue;
+                        }
+                        if constexpr (std::is_invocable_v<Func, entityid, Requested&...>){
+                            invokeRow([&](auto&... components) { func(ids[i], components...); }, columns[i]...);
+                        } else if constexpr (std::is_invocable_v<Func, Requested&...>){
+                            invokeRow(func, columns[i]...);
+                        } else {
+                            static_assert(std::is_invocable_v<Func, entityid, Requested&...> ||
+                                     std::is_invocable_v<Func, Requested&...>,
+                                     "Lambda must accept (entityid, Components&...) or (Components&...)");
+                        }
+                    }
+                });
+        };
+
+        if constexpr (sizeof...(Filters) == 0) {
+            stampRange<Requested...>(begin, end, window.tick);
+            rows(begin, end);
+        } else {
+            forEachPassingBlock<Filters...>(begin, end, window.since, [&](size_t b, size_t e) {
+                stampRange<Requested...>(b, e, window.tick);
+                rows(b, e);
+            });
         }
     }
 
-    size_t size() const {
-        return _entityIds.size();
+    template<typename... Requested, typename... Filters, typename Func>
+    void forEachSpans(typeList<Requested...>, typeList<Filters...>, size_t begin, size_t end,
+                      Func& func, const changeWindow& window) {
+        static_assert(hasComponents<Requested..., Filters...>(), "Component type not in archetype");
+        static_assert((!std::is_same_v<Filters, added<termComponent_t<Filters>>> && ...),
+                      "added<> filters need row iteration (forEachWithComponents)");
+
+        auto spans = [&](size_t b, size_t e) {
+            _storage.template forEachBlock<Requested...>(b, e,
+                [&](const entityid* ids, size_t count, auto... columns) {
+                    if constexpr (std::is_invocable_v<Func, decltype(columnSpan(columns, count))..., std::span<const entityid>>) {
+                        func(columnSpan(columns, count)..., std::span<const entityid>(ids, count));
+                    } else if constexpr (std::is_invocable_v<Func, decltype(columnSpan(columns, count))...>) {
+                        func(columnSpan(columns, count)...);
+                    } else {
+                        static_assert(std::is_invocable_v<Func, decltype(columnSpan(columns, count))...>,
+                                      "Lambda must accept (std::span<Components>..., std::span<const entityid>) "
+                                      "or (std::span<Components>...)");
+                    }
+                });
+        };
+
+        if constexpr (sizeof...(Filters) == 0) {
+            stampRange<Requested...>(begin, end, window.tick);
+            spans(begin, end);
+        } else {
+            forEachPassingBlock<Filters...>(begin, end, window.since, [&](size_t b, size_t e) {
+                stampRange<Requested...>(b, e, window.tick);
+                spans(b, e);
+            });
+        }
     }
 
-    void clear() {
-        _entityIds.clear();
-        std::apply([](auto&... vecs) {
-            (vecs.clear(), ...);
-        }, _components);
+    // Call visit(b, e) for the part of every tracking block in [begin, end)
+    // that may hold rows passing Filters. added<T> rows also stamp T changed,
+    // so both filters reject whole blocks by the changed tick.
+    template<typename... Filters, typename Visit>
+    void forEachPassingBlock(size_t begin, size_t end, uint32_t since, Visit&& visit) {
+        for (size_t b = begin; b < end;) {
+            size_t block = b / TRACK_ROWS;
+            size_t e = std::min((block + 1) * TRACK_ROWS, end);
+            if (((loadTick(_changedTicks[columnIndex<Filters>()][block]) > since) && ...)) {
+                visit(b, e);
+            }
+            b = e;
+        }
+    }
+
+    template<typename Filter>
+    bool rowPasses(size_t row, uint32_t since) const {
+        if constexpr (std::is_same_v<Filter, added<termComponent_t<Filter>>>) {
+            return _addedTicks[columnIndex<Filter>()][row] > since;
+        } else {
+            return true; // changed<> is decided per block
+        }
+    }
+
+    // Stamp the blocks covering [begin, end) of every non-const Requested column.
+    template<typename... Requested>
+    void stampRange(size_t begin, size_t end, uint32_t tick) {
+        if (tick == 0 || begin >= end) {
+            return;
+        }
+        ([&] {
+            if constexpr (!std::is_const_v<Requested>) {
+                auto& ticks = _changedTicks[columnIndex<Requested>()];
+                for (size_t block = begin / TRACK_ROWS; block <= (end - 1) / TRACK_ROWS; ++block) {
+                    raiseTick(ticks[block], tick);
+                }
+            }
+        }(), ...);
+    }
+
+    // Block ticks are shared by TRACK_ROWS rows that parallel callbacks may
+    // write at the same time, so they are read and raised atomically (relaxed:
+    // a tick orders nothing, it is only compared after the writers joined).
+    static void raiseTick(uint32_t& block, uint32_t tick) {
+        std::atomic_ref<uint32_t> ref(block);
+        uint32_t current = ref.load(std::memory_order_relaxed);
+        while (current < tick && !ref.compare_exchange_weak(current, tick, std::memory_order_relaxed)) {
+        }
+    }
+
+    static uint32_t loadTick(const uint32_t& block) {
+        return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(block)).load(std::memory_order_relaxed);
+    }
+
+    // Keep tick arrays sized to the storage after rows were appended.
+    void growTicks() {
+        size_t rows = _storage.size();
+        for (auto& ticks : _addedTicks) {
+            ticks.resize(rows);
+        }
+        size_t blocks = (rows + TRACK_ROWS - 1) / TRACK_ROWS;
+        for (auto& ticks : _changedTicks) {
+            if (ticks.size() < blocks) {
+                ticks.resize(blocks);
+            }
+        }
+        if (_rowVersions.size() < blocks) {
+            _rowVersions.resize(blocks);
+        }
+    }
+
+    // Row src moved into dst: keep its added ticks, and make dst's block at
+    // least as new as src's so the moved data still reads as changed.
+    void moveTicks(size_t dst, size_t src) {
+        for (auto& ticks : _addedTicks) {
+            ticks[dst] = ticks[src];
+        }
+        for (auto& ticks : _changedTicks) {
+            ticks[dst / TRACK_ROWS] = std::max(ticks[dst / TRACK_ROWS], ticks[src / TRACK_ROWS]);
+        }
+    }
+
+    // Block ticks are kept; appended rows get stamped again.
+    void truncateTicks(size_t rows) {
+        for (auto& ticks : _addedTicks) {
+            ticks.resize(rows);
+        }
     }
 
-private:
     // Members
-    std::vector<entityid> _entityIds; // archetypeID -> global entityID mapping for reverse lookup.
-    std::tuple<std::vector<AComponents>...> _components; // Component storage
+    Storage _storage; // Entity ids + component columns
+    std::array<columnVector<uint32_t>, N_COMPONENTS> _addedTicks;      // Per row
+    std::array<columnVector<uint32_t>, N_COMPONENTS> _changedTicks;    // Per TRACK_ROWS block
+    columnVector<uint64_t> _rowVersions; // Per TRACK_ROWS block: _rowVersion when its rows last changed
+    uint64_t _rowVersion = 1;           // Bumped by every checkpoint capture
+};
 
-    // Reference
-    ecs_base* _world = nullptr;  // Non-owning pointer to parent ECS
+// Archetypes are templated over components
+//   archetype<Position, Velocity>                 one std::vector per component
+//   archetype<soa<Position>, Velocity>            Position split into x[] and y[]
+//   archetype<chunked<>, Position, Velocity>      16 KiB chunks, stable addresses
+//   archetype<chunked<64 * 1024>, Position>       custom chunk size
+template<typename ...AComponents>
+class archetype : public archetype_base<vectorStorage<AComponents...>, componentOf_t<AComponents>...> {
+public:
+    using archetype_base<vectorStorage<AComponents...>, componentOf_t<AComponents>...>::archetype_base;
+};
+
+template<size_t ChunkBytes, typename ...AComponents>
+class archetype<chunked<ChunkBytes>, AComponents...>
+    : public archetype_base<chunkStorage<ChunkBytes, AComponents...>, AComponents...> {
+public:
+    using archetype_base<chunkStorage<ChunkBytes, AComponents...>, AComponents...>::archetype_base;
 };
 
 } // namespace gxe
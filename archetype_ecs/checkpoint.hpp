@@ -0,0 +1,68 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace gxe {
+
+// Rollback checkpoints (see ecs::checkpoint / ecs::restore).
+// A checkpoint holds one immutable buffer per column per tracking block
+// (TRACK_ROWS rows). Blocks that did not change since the previous checkpoint
+// share that checkpoint's buffer, so capturing costs a copy of the changed
+// blocks plus one pointer per block.
+using checkpointid = uint64_t;
+
+constexpr inline checkpointid NULL_CHECKPOINT = 0;
+constexpr inline std::size_t DEFAULT_CHECKPOINT_CAPACITY = 8;
+
+using checkpointBuffer = std::shared_ptr<const std::byte[]>;
+
+// Uninitialized buffer and its reference count in one allocation from resource.
+inline std::shared_ptr<std::byte[]> allocateBuffer(std::size_t bytes, std::pmr::memory_resource* resource) {
+    return std::allocate_shared_for_overwrite<std::byte[]>(std::pmr::polymorphic_allocator<std::byte>(resource), bytes);
+}
+
+inline checkpointBuffer copyToBuffer(const void* data, std::size_t bytes, std::pmr::memory_resource* resource) {
+    std::shared_ptr<std::byte[]> buffer = allocateBuffer(bytes, resource);
+    std::memcpy(buffer.get(), data, bytes);
+    return buffer;
+}
+
+// Checkpoints allocate their block lists and copied blocks from the resource
+// they are constructed with.
+struct archetypeCheckpoint {
+    explicit archetypeCheckpoint(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : blocks(resource) {}
+
+    std::pmr::memory_resource* resource() const { return blocks.get_allocator().resource(); }
+
+    std::size_t rows = 0;
+    uint64_t version = 0; // Archetype row version at capture
+    std::pmr::vector<checkpointBuffer> blocks; // [block * (N_COMPONENTS + 1) + column], column 0 = entity ids
+};
+
+// Entity directory state. Records are paged; pages untouched since the
+// previous checkpoint are shared.
+struct idCheckpoint {
+    static constexpr std::size_t PAGE_SLOTS = DIRECTORY_PAGE_SLOTS;
+
+    explicit idCheckpoint(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : pages(resource) {}
+
+    std::pmr::memory_resource* resource() const { return pages.get_allocator().resource(); }
+
+    std::size_t slots = 0;
+    entityid freeHead = NULL_ID;
+    entityid freeTail = NULL_ID;
+    uint32_t numEntities = 0;
+    uint64_t version = 0; // Directory page version at capture
+    std::pmr::vector<checkpointBuffer> pages;
+};
+
+} // namespace gxe
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "profiler.hpp"
+#include "types.hpp"
+
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace gxe {
+
+// Records structural changes (entity creation/destruction) so they can be
+// applied later at a sync point, e.g. while iterating or from worker threads.
+// The ecs keeps one buffer per pool thread, so recording never locks.
+// Buffers keep their capacity between flushes and allocate from resource.
+template<typename ...Archetypes>
+class commandBuffer {
+public:
+    explicit commandBuffer(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _creates(std::pmr::vector<typename Archetypes::componentTuple>(resource)...)
+        , _destroys(resource) {}
+
+    // Queue creation of an entity in Archetype. The entity id is assigned at flush.
+    template<typename Archetype, typename ...ComponentArgs>
+    void create(ComponentArgs&&... components) {
+        static_assert((std::is_same_v<Archetype, Archetypes> || ...),
+                      "Archetype not registered in ECS");
+        pendingCreates<Archetype>().emplace_back(std::forward<ComponentArgs>(components)...);
+        profileChanges(1);
+    }
+
+    // Queue destruction of an entity. Destroying the same entity twice is harmless.
+    void destroy(entityid id) {
+        _destroys.push_back(id);
+        profileChanges(1);
+    }
+
+    void destroy(std::span<const entityid> ids) {
+        _destroys.insert(_destroys.end(), ids.begin(), ids.end());
+        profileChanges(ids.size());
+    }
+
+    bool empty() const {
+        return _destroys.empty() && std::apply([](const auto&... rows) {
+            return (rows.empty() && ...);
+        }, _creates);
+    }
+
+    void clear() {
+        _destroys.clear();
+        std::apply([](auto&... rows) {
+            (rows.clear(), ...);
+        }, _creates);
+    }
+
+    template<typename Archetype>
+    std::pmr::vector<typename Archetype::componentTuple>& pendingCreates() {
+        // By position: archetypes may share a component set (e.g. different storage).
+        return std::get<typeIndex<Archetype, Archetypes...>()>(_creates);
+    }
+
+    std::pmr::vector<entityid>& pendingDestroys() {
+        return _destroys;
+    }
+
+private:
+    std::tuple<std::pmr::vector<typename Archetypes::componentTuple>...> _creates; // Grouped per archetype
+    std::pmr::vector<entityid> _destroys;
+};
+
+} // namespace gxe
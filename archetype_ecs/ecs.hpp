@@ -2,37 +2,49 @@
 
 #include "archetype.hpp"
 #include "archetype_ecs/types.hpp"
+#include "checkpoint.hpp"
+#include "commandBuffer.hpp"
+#include "events.hpp"
 #include "idManager.hpp"
+#include "memory.hpp"
+#include "query.hpp"
+#include "profiler.hpp"
+#include "snapshot.hpp"
 #include "system.hpp"
+#include "threadPool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <cassert>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <stdexcept>
 
 namespace gxe {
 
-struct EntityRecord {
-    size_t archetypeIndex; 
-    archetypeid localId;  // Index within the archetype's component arrays
-    
-    EntityRecord() 
-        : archetypeIndex(std::numeric_limits<size_t>::max())
-        , localId(NULL_ARCHETYPE_ID) {}
-    
-    EntityRecord(size_t archIdx, archetypeid local)
-        : archetypeIndex(archIdx)
-        , localId(local) {}
-    
-    bool isValid() const {
-        return archetypeIndex != std::numeric_limits<size_t>::max();
-    }
+// Change window of the system running on this thread, see ecs::updateSystem.
+struct systemChangeContext {
+    const void* world = nullptr;
+    changeWindow window;
 };
 
+inline thread_local systemChangeContext t_systemChange;
+
 template<typename ...Archetypes>
-class ecs : public ecs_base {
+class ecs {
     static constexpr size_t N_ARCHETYPES = sizeof...(Archetypes);
+    static_assert(N_ARCHETYPES < NULL_ARCHETYPE_INDEX, "Too many archetypes for EntityRecord::archetypeIndex");
 
     template<typename T, typename First, typename ...Rest>
     static constexpr size_t archetypeIndexHelper() {
@@ -50,28 +62,31 @@ class ecs : public ecs_base {
     static constexpr size_t archetypeIndex = archetypeIndexHelper<T, Archetypes...>();
 
 public:
-    ecs() {
-        _entityRecords.reserve(INITIAL_SPARSE_SET_CAPACITY);
-        
-        // Set this ECS as owner for all archetypes
-        std::apply([this](auto&... archetypes) {
-            (archetypes.setWorld(this), ...);
-        }, _archetypes);
-    }
-    
-    ~ecs() override = default;
-
-    // ecs_base interface implementation
-    archetypeid getArchetypeLocalId(entityid id) const override {
-        if (id >= _entityRecords.size()) {
-            return NULL_ARCHETYPE_ID;
+    // Everything the world allocates for entities and while stepping (columns,
+    // entity records, command buffers, checkpoints, event channels, step
+    // scratch) goes through resource, which must be thread safe (see
+    // memory.hpp). Only setup goes to the global heap: the system objects
+    // registerSystem creates, profiler names and the pool's threads.
+    explicit ecs(size_t threadCount = std::thread::hardware_concurrency(),
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _memory(resource)
+        , _idManager(&_memory)
+        , _archetypes(Archetypes(INITIAL_ARCHETYPE_CAPACITY, &_memory)...)
+        , _threadPool(threadCount, &_memory) {
+        _commandBuffers.reserve(_threadPool.threadCount());
+        for (size_t i = 0; i < _threadPool.threadCount(); ++i) {
+            _commandBuffers.emplace_back(&_memory);
         }
-        return _entityRecords[id].localId;
+        setCheckpointCapacity(DEFAULT_CHECKPOINT_CAPACITY);
     }
     
-    void setArchetypeLocalId(entityid id, archetypeid localId) override {
-        assert(id < _entityRecords.size() && "Invalid entity ID");
-        _entityRecords[id].localId = localId;
+    ~ecs() {
+        std::pmr::polymorphic_allocator<> alloc(&_memory);
+        for (auto& page : _eventPages) {
+            if (eventPage* p = page.load(std::memory_order_relaxed)) {
+                alloc.delete_object(p);
+            }
+        }
     }
 
     // Create entity in specified archetype
@@ -83,57 +98,238 @@ public:
         // Allocate global entity ID
         entityid id = _idManager.createEntity();
         
-        // Ensure entity records vector is large enough
-        if (id >= _entityRecords.size()) {
-            _entityRecords.resize(id + INITIAL_SPARSE_SET_CAPACITY);
-        }
-        
         // Add entity to the archetype
         constexpr size_t archIdx = archetypeIndex<Archetype>;
         auto& arch = std::get<Archetype>(_archetypes);
         archetypeid localId = arch.addEntity(id, std::forward<ComponentArgs>(components)...);
+        arch.markAdded(localId, 1, currentWindow().tick);
         
         // Record the entity's location
-        _entityRecords[id] = EntityRecord(archIdx, localId);
-        
+        EntityRecord& record = _idManager.record(id);
+        record.archetypeIndex = archIdx;
+        record.localId = localId;
+
+        profileChanges(1);
         return id;
     }
 
-    // Destroy entity from whatever archetype it's in
+    // Destroy entity from whatever archetype it's in.
+    // Stale handles (already destroyed, slot possibly reused) are ignored.
     void destroyEntity(entityid id) {
-        assert(id < _entityRecords.size() && "Invalid entity ID");
-        
-        EntityRecord& record = _entityRecords[id];
-        if (!record.isValid()) {
+        if (!isValid(id)) {
             return;
         }
         
         // Remove from archetype using runtime dispatch
-        removeFromArchetype(id, record.archetypeIndex);
+        const EntityRecord& record = _idManager.record(id);
+        removeFromArchetype(record.localId, record.archetypeIndex);
         
-        // Clear record and free ID
-        record = EntityRecord();
+        // Free the slot, invalidating the handle
         _idManager.destroyEntity(id);
+        profileChanges(1);
+    }
+
+    // Create count entities in Archetype in one batch: ids and column capacity
+    // are reserved once, then generator(i, Components&...) fills the new rows
+    // in place, column blocks in order. New ids are written to outIds if given.
+    template<typename Archetype, typename Generator>
+    void createEntities(size_t count, Generator&& generator, std::span<entityid> outIds = {}) {
+        static_assert((std::is_same_v<Archetype, Archetypes> || ...),
+                      "Archetype not registered in ECS");
+
+        auto& arch = std::get<Archetype>(_archetypes);
+        archetypeid first = arch.addEntities(allocateBulkIds(count), std::forward<Generator>(generator));
+        arch.markAdded(first, count, currentWindow().tick);
+        placeBulk(archetypeIndex<Archetype>, first, outIds);
+        profileChanges(count);
+    }
+
+    // Create entities from one span per archetype column (all the same length),
+    // copied column by column (memcpy for trivially copyable components):
+    //   world.createEntities<MovingEntity>({positions, velocities});
+    template<typename Archetype>
+    void createEntities(const typename Archetype::columnSpans& columns, std::span<entityid> outIds = {}) {
+        static_assert((std::is_same_v<Archetype, Archetypes> || ...),
+                      "Archetype not registered in ECS");
+
+        auto& arch = std::get<Archetype>(_archetypes);
+        size_t count = std::get<0>(columns).size();
+        archetypeid first = arch.addEntities(allocateBulkIds(count), columns);
+        arch.markAdded(first, count, currentWindow().tick);
+        placeBulk(archetypeIndex<Archetype>, first, outIds);
+        profileChanges(count);
+    }
+
+    // Destroy many entities at once. Removals are sorted per archetype and each
+    // archetype is compacted in a single pass. Stale and duplicate ids are ignored.
+    void destroyEntities(std::span<const entityid> ids) {
+        _pendingIds.assign(ids.begin(), ids.end());
+        destroyPending();
+    }
+
+    // Command buffer of the calling thread. Record creates/destroys here while
+    // iterating or from inside parallel systems; they are applied by
+    // flushCommands(), which step() calls before and after running systems.
+    // Threads outside the pool share one buffer, so only the thread driving
+    // the ecs should record from outside it.
+    commandBuffer<Archetypes...>& commands() {
+        return _commandBuffers[_threadPool.workerIndex()];
+    }
+
+    // Apply all recorded commands. Destroys are grouped per archetype and
+    // compacted in a single pass, then creates are appended per archetype.
+    // Must not be called while iterating.
+    void flushCommands() {
+        profileScope scope(_profiler, profileEvent::FLUSH, _frame, static_cast<uint32_t>(_threadPool.workerIndex()));
+        flushDestroys();
+
+        std::apply([this](auto&... archetypes) {
+            (flushCreates<std::decay_t<decltype(archetypes)>>(), ...);
+        }, _archetypes);
+
+        for (auto& buffer : _commandBuffers) {
+            buffer.clear();
+        }
     }
 
-    // Get component from entity (requires knowing which archetype)
+    // Channel for Event, created on first use (see events.hpp). Callable from
+    // any thread, including parallel systems. Throws std::length_error once
+    // the program uses more than MAX_EVENT_TYPES event types.
+    template<typename Event>
+    eventChannel<Event>& events() {
+        uint32_t id = eventId<Event>();
+        if (id >= MAX_EVENT_TYPES) {
+            throw std::length_error("gxe::ecs::events: more than MAX_EVENT_TYPES event types");
+        }
+        eventPage* page = _eventPages[id / EVENT_PAGE_SLOTS].load(std::memory_order_acquire);
+        eventChannelBase* channel = page ? (*page)[id % EVENT_PAGE_SLOTS].load(std::memory_order_acquire) : nullptr;
+        if (!channel) {
+            std::lock_guard lock(_eventMutex);
+            page = _eventPages[id / EVENT_PAGE_SLOTS].load(std::memory_order_relaxed);
+            if (!page) {
+                page = std::pmr::polymorphic_allocator<>(&_memory).new_object<eventPage>();
+                _eventPages[id / EVENT_PAGE_SLOTS].store(page, std::memory_order_release);
+            }
+            channel = (*page)[id % EVENT_PAGE_SLOTS].load(std::memory_order_relaxed);
+            if (!channel) {
+                _ownedChannels.push_back(makeEventChannel<Event>(DEFAULT_EVENT_CAPACITY, &_memory));
+                channel = _ownedChannels.back().get();
+                (*page)[id % EVENT_PAGE_SLOTS].store(channel, std::memory_order_release);
+            }
+        }
+        return static_cast<eventChannel<Event>&>(*channel);
+    }
+
+    // Get component from entity (requires knowing which archetype).
+    // The record's row is handed straight to the archetype, so in release
+    // builds this is a record load plus a column load, with no indirect calls.
+    // Returns Component&, or a soaRef<Component> proxy if Archetype stores it as soa<>.
+    // Mutable access marks the component changed; ask for const Component to read only.
     template<typename Archetype, typename Component>
-    Component& getComponent(entityid id) {
-        assert(id < _entityRecords.size() && "Invalid entity ID");
+    decltype(auto) getComponent(entityid id) {
+        assert(isValid(id) && "Stale or invalid entity handle");
         
-        EntityRecord& record = _entityRecords[id];
-        assert(record.isValid() && "Entity not valid");
+        const EntityRecord& record = _idManager.record(id);
         assert(record.archetypeIndex == archetypeIndex<Archetype> && "Entity not in specified archetype");
         
         auto& arch = std::get<Archetype>(_archetypes);
-        return arch.template getComponent<Component>(id);
+        if constexpr (!std::is_const_v<Component>) {
+            arch.template markChanged<Component>(record.localId, currentWindow().tick);
+        }
+        return arch.template getComponentAt<Component>(record.localId);
+    }
+
+    // Get a component without knowing the entity's archetype.
+    // Returns a soaRef<Component> proxy if any archetype stores it as soa<>.
+    template<typename Component>
+    decltype(auto) getComponent(entityid id) {
+        assert(isValid(id) && "Stale or invalid entity handle");
+
+        auto get = componentGetters<Component>[_idManager.record(id).archetypeIndex];
+        assert(get && "Entity does not have component");
+        return get(*this, id);
+    }
+
+    // Like getComponent, but returns nullptr for stale handles or when the
+    // entity's archetype lacks the component (a null soaRef for soa<> components).
+    template<typename Component>
+    auto tryGetComponent(entityid id) {
+        constexpr bool proxy = !std::is_reference_v<componentRef<Component>>;
+        using result = std::conditional_t<proxy, soaRef<Component>, Component*>;
+        if (!isValid(id)) {
+            return result{};
+        }
+        auto get = componentGetters<Component>[_idManager.record(id).archetypeIndex];
+        if (!get) {
+            return result{};
+        }
+        if constexpr (proxy) {
+            return get(*this, id);
+        } else {
+            return &get(*this, id);
+        }
+    }
+
+    // Check whether an entity's current archetype has a component
+    template<typename Component>
+    bool hasComponent(entityid id) const {
+        static constexpr std::array<bool, N_ARCHETYPES> has{
+            Archetypes::template hasComponent<Component>()...
+        };
+        return isValid(id) && has[_idManager.record(id).archetypeIndex];
+    }
+
+    // Add a component to an entity, moving it to the registered archetype whose
+    // component set is its current set plus Component. Transitions are resolved
+    // at compile time into one table per component type, so this is a single
+    // table lookup plus an O(components) row move.
+    // Returns false, leaving the entity as it was, for a stale handle or when
+    // no archetype with the resulting component set is registered.
+    template<typename Component>
+    [[nodiscard]] bool addComponent(entityid id, Component value) {
+        using mover = void (*)(ecs&, entityid, Component&&);
+        static constexpr std::array<mover, N_ARCHETYPES> edges = []<size_t... I>(std::index_sequence<I...>) {
+            return std::array<mover, N_ARCHETYPES>{addEdge<Component, I>()...};
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+
+        if (!isValid(id)) {
+            return false;
+        }
+        mover move = edges[_idManager.record(id).archetypeIndex];
+        if (!move) {
+            return false;
+        }
+        move(*this, id, std::move(value));
+        return true;
+    }
+
+    // Remove a component from an entity, moving it to the registered archetype
+    // whose component set is its current set minus Component. Fails like
+    // addComponent.
+    template<typename Component>
+    [[nodiscard]] bool removeComponent(entityid id) {
+        using mover = void (*)(ecs&, entityid);
+        static constexpr std::array<mover, N_ARCHETYPES> edges = []<size_t... I>(std::index_sequence<I...>) {
+            return std::array<mover, N_ARCHETYPES>{removeEdge<Component, I>()...};
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+
+        if (!isValid(id)) {
+            return false;
+        }
+        mover move = edges[_idManager.record(id).archetypeIndex];
+        if (!move) {
+            return false;
+        }
+        move(*this, id);
+        return true;
     }
 
     // Iterate over all entities in a specific archetype
     template<typename Archetype, typename Func>
     void forEach(Func&& func) {
         auto& arch = std::get<Archetype>(_archetypes);
-        arch.forEach(std::forward<Func>(func));
+        profileEntities(arch.size());
+        arch.forEach(std::forward<Func>(func), currentWindow());
     }
 
     // Iterate over entities with only specific components
@@ -142,18 +338,109 @@ public:
     template<typename Archetype, typename... Components, typename Func>
     void forEachWith(Func&& func) {
         auto& arch = std::get<Archetype>(_archetypes);
-        arch.template forEachWith<Components...>(std::forward<Func>(func));
+        profileEntities(arch.size());
+        arch.template forEachWith<Components...>(std::forward<Func>(func), currentWindow());
     }
 
     // For each archetype with the set of components,
-    // iterate over some sub-selection of the components
+    // iterate over some sub-selection of the components.
+    // Components may include filters and read-only requests (see query.hpp):
+    //   forEachWithComponents<const Position, EColor, changed<Position>>(...)
+    // visits only rows whose Position changed since the calling system last ran,
+    // and marks EColor (but not Position) as changed.
+    // Any query term works here too, e.g. <Position, Velocity, without<Static>>.
     template<typename ...Components, typename Func>
     void forEachWithComponents(Func&& func){
-        std::apply([&](auto&... archetypes) { // std::apply unpacks the _archetypes tuple and applies the lambda to it
-            ((archetypes.template hasComponents<Components...>() ? 
-                archetypes.template forEachWith<Components...>(std::forward<Func>(func)) : 
-                void()), ...);
-        }, _archetypes);
+        forEachQuery<query<Components...>>(std::forward<Func>(func));
+    }
+
+    // Parallel variant of forEachWithComponents.
+    // Every matching archetype is cut into row ranges of `grain` entities and all
+    // ranges go into a single batch on the thread pool, so small and large
+    // archetypes balance across workers. func must be safe to call concurrently
+    // on different entities, and must not create or destroy entities.
+    // grain == 0 uses the world's grain size (see setParallelGrainSize).
+    template<typename ...Components, typename Func>
+    void forEachWithComponentsParallel(Func&& func, size_t grain = 0) {
+        forEachQueryParallel<query<Components...>>(std::forward<Func>(func), grain);
+    }
+
+    // Iterate a query (see query.hpp):
+    //   using Movers = query<with<Position, Velocity>, without<Static>, optional<EColor>>;
+    //   world.forEachQuery<Movers>([](entityid id, Position& pos, Velocity& vel, EColor* color) { ... });
+    // The matching archetypes are resolved once per query type at compile time,
+    // so a call only touches those archetypes.
+    template<typename Query, typename Func>
+    void forEachQuery(Func&& func) {
+        changeWindow window = currentWindow();
+        forEachMatching<Query>([&](auto& arch) {
+            profileEntities(arch.size());
+            queryRange<Query>(arch, 0, arch.size(), func, window);
+        });
+    }
+
+    // Parallel variant of forEachQuery, same rules as forEachWithComponentsParallel.
+    template<typename Query, typename Func>
+    void forEachQueryParallel(Func&& func, size_t grain = 0) {
+        auto range = [&func, window = currentWindow()](auto& arch, size_t begin, size_t end) {
+            queryRange<Query>(arch, begin, end, func, window);
+        };
+        runParallelRanges<Query>(range, grain);
+    }
+
+    // Entities in the archetypes matching a query (row filters not applied).
+    template<typename Query>
+    size_t queryCount() {
+        size_t count = 0;
+        forEachMatching<Query>([&](auto& arch) {
+            count += arch.size();
+        });
+        return count;
+    }
+
+    // Number of registered archetypes a query matches.
+    template<typename Query>
+    static constexpr size_t queryArchetypeCount() {
+        return matchingArchetypes<Query>.size();
+    }
+
+    // For each archetype with the set of components, hand contiguous blocks of
+    // the requested columns to func as spans (see archetype::forEachChunk):
+    //   world.forEachChunk<Position, Velocity>(
+    //       [](std::span<Position> pos, std::span<Velocity> vel, std::span<const entityid> ids) { ... });
+    // without<> terms apply; optional<> terms are not supported.
+    template<typename ...Components, typename Func>
+    void forEachChunk(Func&& func) {
+        using chunkQuery = query<Components...>;
+        changeWindow window = currentWindow();
+        forEachMatching<chunkQuery>([&](auto& arch) {
+            profileEntities(arch.size());
+            chunkRange<chunkQuery>(arch, 0, arch.size(), func, window);
+        });
+    }
+
+    // Parallel variant of forEachChunk. Ranges are rounded to whole chunks (or
+    // cache-line multiples of rows) so every span stays aligned.
+    template<typename ...Components, typename Func>
+    void forEachChunkParallel(Func&& func, size_t grain = 0) {
+        auto range = [&func, window = currentWindow()](auto& arch, size_t begin, size_t end) {
+            chunkRange<query<Components...>>(arch, begin, end, func, window);
+        };
+        runParallelRanges<query<Components...>>(range, grain);
+    }
+
+    // Rows per parallel range. 0 picks a range that keeps the requested
+    // columns around PARALLEL_RANGE_BYTES.
+    void setParallelGrainSize(size_t rows) {
+        _parallelGrainSize = rows;
+    }
+
+    size_t parallelGrainSize() const {
+        return _parallelGrainSize;
+    }
+
+    threadPool& pool() {
+        return _threadPool;
     }
 
     // Get archetype instance
@@ -172,15 +459,16 @@ public:
         return _idManager.entityCount();
     }
 
-    // Check if entity is valid
+    // Check if entity is valid: the handle's generation matches its slot, so
+    // handles to destroyed (and possibly reused) slots are rejected.
     bool isValid(entityid id) const {
-        return id < _entityRecords.size() && _entityRecords[id].isValid();
+        return _idManager.isAlive(id);
     }
 
     // Get which archetype index an entity belongs to
     size_t getEntityArchetypeIndex(entityid id) const {
-        assert(id < _entityRecords.size() && "Invalid entity ID");
-        return _entityRecords[id].archetypeIndex;
+        assert(isValid(id) && "Stale or invalid entity handle");
+        return _idManager.record(id).archetypeIndex;
     }
 
     // Register a system using a template-template parameter
@@ -194,7 +482,9 @@ public:
         
         auto system = std::make_unique<ConcreteSystem>(*this, std::forward<Args>(args)...);
         auto& ref = *system;
+        _systemProfileIds.push_back(registerProfileName(typeName<ConcreteSystem>()));
         _systems.push_back(std::move(system));
+        _scheduleDirty = true;
         return ref;
     }
 
@@ -217,34 +507,915 @@ public:
     }
 
     // API for allowing specific DT to be passed into the update loop.
+    // Systems are ordered by registration, but systems whose declared component
+    // access does not conflict run concurrently on the thread pool.
     void step(float dt) {
-        for (auto& system : _systems) {
-            system->update(dt);
+        ++_frame;
+        profileScope scope(_profiler, profileEvent::STEP, _frame, static_cast<uint32_t>(_threadPool.workerIndex()));
+        flushCommands();
+        runSystems(dt);
+        flushCommands();
+        swapEvents();
+    }
+
+    // Systems known at compile time, held by value and updated in list order
+    // through direct calls instead of the vtable, so their query loops can be
+    // inlined into the step. Systems registered with registerSystem (e.g.
+    // runtime plugins) run after them, scheduled as in ecs::step.
+    //   World::pipeline<PhysicsSystem, SpatialSystem> systems(world);
+    //   systems.step(dt); // Instead of world.step(dt)
+    // Each system is constructed from the world alone and must expose a public tick.
+    template<template<typename> class ...Systems>
+    class pipeline {
+    public:
+        explicit pipeline(ecs& world)
+            : _world(world)
+            , _systems(((void)sizeof(Systems<ecs>*), world)...)
+            , _profileIds{world.registerProfileName(typeName<Systems<ecs>>())...} {}
+
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        template<template<typename> class System>
+        System<ecs>& get() {
+            return std::get<System<ecs>>(_systems);
         }
+
+        void step(float dt) {
+            ecs& world = _world;
+            ++world._frame;
+            profileScope scope(world._profiler, profileEvent::STEP, world._frame,
+                               static_cast<uint32_t>(world._threadPool.workerIndex()));
+            world.flushCommands();
+            [&]<size_t ...I>(std::index_sequence<I...>) {
+                (world.runInWindow(std::get<I>(_systems), _profileIds[I], [&](auto& system) {
+                    return system.template updateDirect<std::decay_t<decltype(system)>>(dt);
+                }), ...);
+            }(std::make_index_sequence<sizeof...(Systems)>{});
+            world.runSystems(dt);
+            world.flushCommands();
+            world.swapEvents();
+        }
+
+    private:
+        ecs& _world;
+        std::tuple<Systems<ecs>...> _systems;
+        std::array<uint32_t, sizeof...(Systems)> _profileIds; // Profiler system ids
+    };
+
+    // Toggle concurrent system execution in step(). On by default.
+    void setParallelSystems(bool enabled) {
+        _parallelSystems = enabled;
     }
 
     size_t systemCount() const {
         return _systems.size();
     }
 
+    // Per-system timings, substeps, entities visited and structural changes of
+    // recent steps; see profiler.hpp. Compiled out with GXE_PROFILE=0.
+    profiler& getProfiler() {
+        return _profiler;
+    }
+
+    const profiler& getProfiler() const {
+        return _profiler;
+    }
+
+    // Allocations made through the world's memory resource so far. In steady
+    // state (no growth) a step adds none.
+    memoryStats memoryUsage() const {
+        return _memory.stats();
+    }
+
+    // The world's resource, for allocating state that should share it.
+    std::pmr::memory_resource* memoryResource() {
+        return &_memory;
+    }
+
+    // Number of step(dt) calls so far.
+    uint64_t frame() const {
+        return _frame;
+    }
+
+    // Write the whole world (entity records, the id free list and every
+    // archetype's columns as raw aligned arrays, see snapshot.hpp).
+    // Systems, pending commands and change ticks are not part of a snapshot.
+    bool saveSnapshot(snapshotWriter& out) {
+        snapshotHeader header;
+        header.archetypes = N_ARCHETYPES;
+        header.layout = snapshotLayout();
+        out.value(header);
+        _idManager.save(out);
+        std::apply([&](auto&... archetypes) {
+            (archetypes.saveSnapshot(out), ...);
+        }, _archetypes);
+        return out.finish();
+    }
+
+    bool saveSnapshot(const std::string& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        snapshotWriter out(file);
+        return saveSnapshot(out);
+    }
+
+    // Streaming save: the world is copied into memory on the calling thread
+    // (one copy per column), the file is written on another thread.
+    std::future<bool> saveSnapshotAsync(const std::string& path) {
+        snapshotWriter out;
+        out.reserve(snapshotBytes());
+        saveSnapshot(out);
+        return std::async(std::launch::async, [path, bytes = out.take()] {
+            return writeFile(path, bytes);
+        });
+    }
+
+    // Replace the world with a snapshot. Files are memory mapped and every
+    // column is bulk copied out of the mapping (memcpy per column or chunk).
+    // Returns false, leaving the world untouched, if the snapshot was written
+    // by a different ecs type or version; on truncated or inconsistent data the
+    // world is left empty. Pending commands are dropped; every loaded entity
+    // counts as added at the current tick.
+    bool loadSnapshot(const std::string& path) {
+        mappedFile file(path);
+        return file.isOpen() && loadSnapshot(file.bytes());
+    }
+
+    bool loadSnapshot(std::span<const std::byte> bytes) {
+        snapshotReader in(bytes);
+        snapshotHeader header;
+        if (!in.value(header) || std::memcmp(header.magic, snapshotHeader{}.magic, sizeof(header.magic)) != 0 ||
+            header.version != SNAPSHOT_VERSION || header.archetypes != N_ARCHETYPES ||
+            header.layout != snapshotLayout()) {
+            return false;
+        }
+
+        for (auto& buffer : _commandBuffers) {
+            buffer.clear();
+        }
+        std::apply([](auto&... archetypes) {
+            (archetypes.clear(), ...);
+        }, _archetypes);
+        clearCheckpoints();
+
+        bool ok = _idManager.load(in);
+        size_t rows = 0;
+        uint32_t tick = currentWindow().tick;
+        std::apply([&](auto&... archetypes) {
+            ([&](auto& arch) {
+                if (ok && (ok = arch.loadSnapshot(in))) {
+                    arch.markAdded(0, arch.size(), tick);
+                    rows += arch.size();
+                }
+            }(archetypes), ...);
+        }, _archetypes);
+
+        if (!ok || rows != size_t(_idManager.entityCount()) || !recordsMatchRows()) {
+            std::apply([](auto&... archetypes) {
+                (archetypes.clear(), ...);
+            }, _archetypes);
+            _idManager.clear();
+            return false;
+        }
+        profileChanges(rows);
+        return true;
+    }
+
+    // Upper bound of a snapshot's size in bytes.
+    size_t snapshotBytes() const {
+        return std::apply([this](const auto&... archetypes) {
+            return sizeof(snapshotHeader) + _idManager.snapshotBytes() + (archetypes.snapshotBytes() + ... + 0);
+        }, _archetypes);
+    }
+
+    // Fingerprint of the archetype list and component layouts; snapshots only
+    // load into the ecs type that wrote them.
+    static uint64_t snapshotLayout() {
+        static const uint64_t layout = [] {
+            uint64_t hash = hashValue(N_ARCHETYPES, hashBytes("gxe::ecs"));
+            ((hash = hashComponents(hash, static_cast<typename Archetypes::componentTuple*>(nullptr))), ...);
+            return hash;
+        }();
+        return layout;
+    }
+
+    // Rollback: capture the whole world (entities, records and every column)
+    // into a ring of the last checkpointCapacity() checkpoints. Capture copies
+    // only the blocks (TRACK_ROWS rows of a column) written or restructured
+    // since the previous checkpoint and shares the rest, so its cost follows
+    // the number of changed entities rather than the world size.
+    // Take checkpoints between steps; pending commands are not captured.
+    checkpointid checkpoint() {
+        uint32_t tick = ++_changeTick;
+        const worldCheckpoint* previous = findCheckpoint(_lastCheckpoint);
+
+        worldCheckpoint captured(&_memory);
+        captured.id = ++_lastCheckpoint;
+        captured.tick = tick;
+        _idManager.checkpoint(captured.ids, previous ? &previous->ids : nullptr);
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (std::get<I>(_archetypes).captureCheckpoint(std::get<I>(captured.archetypes),
+                previous ? &std::get<I>(previous->archetypes) : nullptr, previous ? previous->tick : 0), ...);
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+
+        _checkpoints[captured.id % _checkpoints.size()] = std::move(captured);
+        return _lastCheckpoint;
+    }
+
+    // Roll the world back to a checkpoint still in the ring. Only blocks
+    // changed since the checkpoint are copied back; they read as changed to
+    // changed<> filters afterwards. Pending commands are dropped. Returns false
+    // if the checkpoint was evicted (or never existed).
+    bool restore(checkpointid id) {
+        const worldCheckpoint* checkpoint = findCheckpoint(id);
+        if (!checkpoint) {
+            return false;
+        }
+        uint32_t tick = ++_changeTick;
+
+        for (auto& buffer : _commandBuffers) {
+            buffer.clear();
+        }
+        _idManager.restore(checkpoint->ids);
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (std::get<I>(_archetypes).restoreCheckpoint(std::get<I>(checkpoint->archetypes), checkpoint->tick, tick,
+                [this](entityid entity, archetypeid row) {
+                    EntityRecord& record = _idManager.record(entity);
+                    record.archetypeIndex = I;
+                    record.localId = row;
+                }), ...);
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+        return true;
+    }
+
+    // Checkpoints kept in the ring (at least 1). Resizing drops all of them.
+    void setCheckpointCapacity(size_t count) {
+        _checkpoints.clear();
+        _checkpoints.reserve(std::max<size_t>(count, 1));
+        while (_checkpoints.size() < std::max<size_t>(count, 1)) {
+            _checkpoints.emplace_back(&_memory);
+        }
+    }
+
+    size_t checkpointCapacity() const {
+        return _checkpoints.size();
+    }
+
+    // Latest change tick handed out. Every system run takes a new tick; writes
+    // outside systems are stamped one past the latest.
+    uint32_t changeTick() const {
+        return _changeTick.load(std::memory_order_relaxed);
+    }
+
 private:
-    // Runtime dispatch to remove entity from archetype by index
+    // Indices of the archetypes matching Query, resolved at compile time.
+    template<typename Query>
+    static constexpr auto matchingArchetypes = [] {
+        constexpr std::array<bool, N_ARCHETYPES> match{queryMatches<Query, Archetypes>()...};
+        std::array<size_t, std::count(match.begin(), match.end(), true)> indices{};
+        for (size_t i = 0, k = 0; i < N_ARCHETYPES; ++i) {
+            if (match[i]) {
+                indices[k++] = i;
+            }
+        }
+        return indices;
+    }();
+
+    // visit(arch) for every archetype matching Query.
+    template<typename Query, typename Visit>
+    void forEachMatching(Visit&& visit) {
+        constexpr auto& matched = matchingArchetypes<Query>;
+        [&]<size_t... K>(std::index_sequence<K...>) {
+            (visit(std::get<matched[K]>(_archetypes)), ...);
+        }(std::make_index_sequence<matched.size()>{});
+    }
+
+    // Rows [begin, end) of arch for a query: optional components the archetype
+    // holds are iterated as well and handed to func as pointers.
+    template<typename Query, typename Archetype, typename Func>
+    static void queryRange(Archetype& arch, size_t begin, size_t end, Func& func, const changeWindow& window) {
+        using parts = queryParts<Query>;
+        [&]<typename ...Rows, typename ...Optionals>(typeList<Rows...>, typeList<Optionals...>) {
+            if constexpr (sizeof...(Optionals) == 0) {
+                arch.template forEachWithRange<Rows...>(begin, end, func, window);
+            } else {
+                [&]<typename ...Present>(typeList<Present...>) {
+                    arch.template forEachWithRange<Rows..., Present...>(begin, end,
+                        optionalRows<Optionals...>(queryComponents<Rows...>{}, func), window);
+                }(presentComponents<Archetype, Optionals...>{});
+            }
+        }(typename parts::rows{}, typename parts::optionals{});
+    }
+
+    template<typename Query, typename Archetype, typename Func>
+    static void chunkRange(Archetype& arch, size_t begin, size_t end, Func& func, const changeWindow& window) {
+        using parts = queryParts<Query>;
+        static_assert(std::is_same_v<typename parts::optionals, typeList<>>,
+                      "optional<> terms are not supported by chunk iteration");
+        [&]<typename ...Rows>(typeList<Rows...>) {
+            arch.template forEachChunkRange<Rows...>(begin, end, func, window);
+        }(typename parts::rows{});
+    }
+
+    // Adapt func([entityid,] Components&..., Optionals*...) to the row callback
+    // of an archetype iterating Components plus the optionals it holds.
+    template<typename ...Optionals, typename ...Components, typename Func>
+    static auto optionalRows(typeList<Components...>, Func& func) {
+        constexpr bool withId = std::is_invocable_v<Func&, entityid, Components&..., Optionals*...>;
+        static_assert(withId || std::is_invocable_v<Func&, Components&..., Optionals*...>,
+                      "Lambda must accept ([entityid,] Components&..., Optionals*...)");
+        constexpr size_t head = sizeof...(Components) + (withId ? 1 : 0);
+
+        auto call = [&func](auto&... refs) {
+            auto all = std::forward_as_tuple(refs...);
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                func(std::get<I>(all)..., optionalPtr<Optionals, head>(all)...);
+            }(std::make_index_sequence<head>{});
+        };
+        if constexpr (withId) {
+            return [call](entityid id, auto&... refs) -> void { call(id, refs...); };
+        } else {
+            return [call](auto&... refs) -> void { call(refs...); };
+        }
+    }
+
+    // Address of the first ref at or after I holding Optional, or nullptr.
+    template<typename Optional, size_t I, typename Refs>
+    static Optional* optionalPtr(Refs& refs) {
+        if constexpr (I == std::tuple_size_v<Refs>) {
+            return nullptr;
+        } else if constexpr (std::is_same_v<std::remove_cvref_t<std::tuple_element_t<I, Refs>>,
+                                            std::remove_const_t<Optional>>) {
+            return &std::get<I>(refs);
+        } else {
+            return optionalPtr<Optional, I + 1>(refs);
+        }
+    }
+
+    // Cut every archetype matching Query into aligned row ranges and run
+    // range(arch, begin, end) for all of them as one batch on the thread pool.
+    template<typename Query, typename RangeFunc>
+    void runParallelRanges(RangeFunc& range, size_t grain) {
+        if (grain == 0) {
+            grain = _parallelGrainSize > 0 ? _parallelGrainSize : defaultGrainSize<Query>();
+        }
+
+        // One type-erased job per archetype; tasks carry the row range. Workers
+        // take on the caller's change window, so writes they make through
+        // getComponent are stamped like the ones made by the iteration itself.
+        struct rangeJob {
+            void (*run)(void* arch, void* range, size_t begin, size_t end);
+            void* arch;
+            void* range;
+            systemChangeContext change;
+        };
+        std::array<rangeJob, matchingArchetypes<Query>.size()> jobs{};
+        std::atomic<size_t> pending(0);
+        size_t taskCount = 0;
+        forEachMatching<Query>([&](auto& arch) {
+            size_t archGrain = std::decay_t<decltype(arch)>::alignedGrain(grain);
+            taskCount += (arch.size() + archGrain - 1) / archGrain;
+        });
+        std::pmr::vector<task> tasks(_threadPool.scratch());
+        tasks.reserve(taskCount);
+
+        size_t jobIdx = 0;
+        forEachMatching<Query>([&](auto& arch) {
+            using ArchetypeType = std::decay_t<decltype(arch)>;
+            rangeJob& job = jobs[jobIdx++];
+            job.run = [](void* a, void* r, size_t begin, size_t end) {
+                (*static_cast<RangeFunc*>(r))(*static_cast<ArchetypeType*>(a), begin, end);
+            };
+            job.arch = &arch;
+            job.range = &range;
+            job.change = systemChangeContext{this, currentWindow()};
+
+            size_t count = arch.size();
+            size_t archGrain = ArchetypeType::alignedGrain(grain);
+            profileEntities(count);
+            for (size_t begin = 0; begin < count; begin += archGrain) {
+                tasks.push_back(task{
+                    [](void* ctx, size_t b, size_t e) {
+                        auto* j = static_cast<rangeJob*>(ctx);
+                        systemChangeContext outer = t_systemChange;
+                        t_systemChange = j->change;
+                        j->run(j->arch, j->range, b, e);
+                        t_systemChange = outer;
+                    },
+                    &job,
+                    begin,
+                    std::min(begin + archGrain, count),
+                    &pending
+                });
+            }
+        });
+
+        if (tasks.empty()) {
+            return;
+        }
+        if (tasks.size() == 1 || _threadPool.threadCount() == 1) {
+            for (const task& t : tasks) {
+                t.fn(t.ctx, t.begin, t.end);
+            }
+            return;
+        }
+
+        pending.store(tasks.size(), std::memory_order_relaxed);
+        _threadPool.submit(tasks);
+        _threadPool.wait(pending);
+    }
+
+    // Ticks for the calling thread: the running system's window (also on the
+    // workers of its parallel iterations), or "stamp after everything so far"
+    // outside systems (filters then match all rows).
+    changeWindow currentWindow() const {
+        if (t_systemChange.world == this) {
+            return t_systemChange.window;
+        }
+        return changeWindow{0, _changeTick.load(std::memory_order_relaxed) + 1};
+    }
+
+    template<typename Query>
+    static constexpr size_t defaultGrainSize() {
+        using parts = queryParts<Query>;
+        constexpr size_t rowBytes = []<typename ...Rows, typename ...Optionals>(typeList<Rows...>, typeList<Optionals...>) {
+            return (sizeof(termComponent_t<Rows>) + ... + 0) + (sizeof(termComponent_t<Optionals>) + ... + 0);
+        }(typename parts::rows{}, typename parts::optionals{});
+        return rowBytes > 0 && PARALLEL_RANGE_BYTES / rowBytes > 0 ? PARALLEL_RANGE_BYTES / rowBytes : 1;
+    }
+
+    // Build the system DAG: an edge i -> j (i registered before j) for every
+    // pair of systems whose component access conflicts.
+    void buildSchedule() {
+        size_t n = _systems.size();
+        _schedule.assign(n, systemNode{});
+        _successors.clear();
+        for (size_t i = 0; i < n; ++i) {
+            _schedule[i].firstSuccessor = static_cast<uint32_t>(_successors.size());
+            for (size_t j = i + 1; j < n; ++j) {
+                if (_systems[i]->conflictsWith(*_systems[j])) {
+                    _successors.push_back(static_cast<uint32_t>(j));
+                    _schedule[j].predecessors++;
+                }
+            }
+            _schedule[i].successorCount = static_cast<uint32_t>(_successors.size()) - _schedule[i].firstSuccessor;
+        }
+        _remaining.assign(n, 0);
+        _scheduleDirty = false;
+    }
+
+    void runSchedule(float dt) {
+        size_t n = _systems.size();
+        std::atomic<size_t> pending(n);
+        _stepDt = dt;
+        _stepPending = &pending;
+
+        std::pmr::vector<task> roots(_threadPool.scratch());
+        roots.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            std::atomic_ref<uint32_t>(_remaining[i]).store(_schedule[i].predecessors, std::memory_order_relaxed);
+            if (_schedule[i].predecessors == 0) {
+                roots.push_back(systemTask(i));
+            }
+        }
+
+        _threadPool.submit(roots);
+        _threadPool.wait(pending);
+        _stepPending = nullptr;
+    }
+
+    task systemTask(size_t index) {
+        return task{
+            [](void* ctx, size_t i, size_t) { static_cast<ecs*>(ctx)->runSystem(i); },
+            this,
+            index,
+            index + 1,
+            _stepPending
+        };
+    }
+
+    // Run one system inside its change window: filters compare against its
+    // previous run, writes are stamped with a fresh tick.
+    void updateSystem(size_t index, float dt) {
+        runInWindow(*_systems[index], _systemProfileIds[index], [dt](SystemBase& system) {
+            return system.update(dt);
+        });
+    }
+
+    // Run update(system) inside the system's change window and profile it
+    // under profileId. update returns the substeps run.
+    template<typename System, typename Update>
+    void runInWindow(System& system, uint32_t profileId, Update&& update) {
+        profileScope scope(_profiler, profileId, _frame, static_cast<uint32_t>(_threadPool.workerIndex()));
+        uint32_t tick = _changeTick.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        systemChangeContext outer = t_systemChange;
+        t_systemChange = systemChangeContext{this, changeWindow{system.lastRunTick(), tick}};
+        uint32_t substeps = update(system);
+        scope.setSubsteps(substeps);
+        t_systemChange = outer;
+        if (substeps > 0) { // A fixed-rate system that ran no tick still has to see this frame's writes
+            system.setLastRunTick(tick);
+        }
+    }
+
+    // Registered systems: in order, or as a DAG on the pool when enabled.
+    void runSystems(float dt) {
+        if (!_parallelSystems || _systems.size() < 2 || _threadPool.threadCount() == 1) {
+            for (size_t i = 0; i < _systems.size(); ++i) {
+                updateSystem(i, dt);
+            }
+        } else {
+            if (_scheduleDirty) {
+                buildSchedule();
+            }
+            runSchedule(dt);
+        }
+    }
+
+    // Profiler id for the next system, dynamic or pipeline.
+    uint32_t registerProfileName(std::string_view name) {
+        uint32_t id = _profileSystems++;
+        _profiler.setSystemName(id, name);
+        return id;
+    }
+
+    // Runs on a pool thread; releases successors whose dependencies are done.
+    void runSystem(size_t index) {
+        updateSystem(index, _stepDt);
+
+        const systemNode& node = _schedule[index];
+        for (uint32_t next : std::span(_successors).subspan(node.firstSuccessor, node.successorCount)) {
+            if (std::atomic_ref<uint32_t>(_remaining[next]).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                task t = systemTask(next);
+                _threadPool.submit(std::span<const task>(&t, 1));
+            }
+        }
+    }
+
+    // End of step: what was sent becomes readable. No system may be running.
+    void swapEvents() {
+        for (auto& channel : _ownedChannels) {
+            channel->swap();
+        }
+    }
+
+    void flushDestroys() {
+        _pendingIds.clear();
+        for (auto& buffer : _commandBuffers) {
+            auto& destroys = buffer.pendingDestroys();
+            _pendingIds.insert(_pendingIds.end(), destroys.begin(), destroys.end());
+        }
+        destroyPending();
+    }
+
+    // Destroy every entity in _pendingIds: dedupe, bucket rows per archetype,
+    // compact each archetype in one pass, then free the ids.
+    void destroyPending() {
+        if (_pendingIds.empty()) {
+            return;
+        }
+
+        std::sort(_pendingIds.begin(), _pendingIds.end());
+        _pendingIds.erase(std::unique(_pendingIds.begin(), _pendingIds.end()), _pendingIds.end());
+
+        // Rows to remove, bucketed by archetype
+        for (auto& rows : _pendingRows) {
+            rows.clear();
+        }
+        for (entityid id : _pendingIds) {
+            if (isValid(id)) {
+                const EntityRecord& record = _idManager.record(id);
+                _pendingRows[record.archetypeIndex].push_back(record.localId);
+            }
+        }
+
+        size_t archIdx = 0;
+        std::apply([this, &archIdx](auto&... archetypes) {
+            ([&](auto& arch) {
+                auto& rows = _pendingRows[archIdx++];
+                std::sort(rows.begin(), rows.end(), std::greater<archetypeid>());
+                arch.removeRows(rows, [this](entityid moved, archetypeid row) {
+                    _idManager.record(moved).localId = row;
+                });
+            }(archetypes), ...);
+        }, _archetypes);
+
+        for (entityid id : _pendingIds) {
+            if (isValid(id)) {
+                _idManager.destroyEntity(id);
+                profileChanges(1);
+            }
+        }
+    }
+
+    template<typename Archetype>
+    void flushCreates() {
+        for (auto& buffer : _commandBuffers) {
+            auto& rows = buffer.template pendingCreates<Archetype>();
+            if (rows.empty()) {
+                continue;
+            }
+            createEntities<Archetype>(rows.size(), [&rows](size_t i, auto&... components) {
+                std::tie(components...) = std::move(rows[i]);
+            });
+        }
+    }
+
+    // Allocate count ids into _bulkIds.
+    std::span<const entityid> allocateBulkIds(size_t count) {
+        _bulkIds.resize(count);
+        _idManager.createEntities(_bulkIds);
+        return _bulkIds;
+    }
+
+    // Point the records of _bulkIds at consecutive rows starting at first.
+    void placeBulk(size_t archIdx, archetypeid first, std::span<entityid> outIds) {
+        assert((outIds.empty() || outIds.size() == _bulkIds.size()) && "outIds must hold one id per entity");
+        for (size_t i = 0; i < _bulkIds.size(); ++i) {
+            EntityRecord& record = _idManager.record(_bulkIds[i]);
+            record.archetypeIndex = archIdx;
+            record.localId = first + static_cast<archetypeid>(i);
+        }
+        if (!outIds.empty()) {
+            std::copy(_bulkIds.begin(), _bulkIds.end(), outIds.begin());
+        }
+    }
+
+    // Every archetype row belongs to a live entity whose record points back
+    // at it. With as many rows as live entities, that makes every live record
+    // point at a valid row too.
+    bool recordsMatchRows() const {
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            return ([&](const auto& arch) {
+                for (size_t row = 0; row < arch.size(); ++row) {
+                    entityid id = arch.getEntityId(static_cast<archetypeid>(row));
+                    if (!isValid(id)) {
+                        return false;
+                    }
+                    const EntityRecord& record = _idManager.record(id);
+                    if (record.archetypeIndex != I || record.localId != row) {
+                        return false;
+                    }
+                }
+                return true;
+            }(std::get<I>(_archetypes)) && ...);
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+    }
+
+    struct worldCheckpoint {
+        explicit worldCheckpoint(std::pmr::memory_resource* resource)
+            : ids(resource)
+            , archetypes([resource]<size_t... I>(std::index_sequence<I...>) {
+                return std::array<archetypeCheckpoint, N_ARCHETYPES>{((void)I, archetypeCheckpoint(resource))...};
+            }(std::make_index_sequence<N_ARCHETYPES>{})) {}
+
+        // Back to an empty slot, releasing the buffers it held.
+        void reset() {
+            id = NULL_CHECKPOINT;
+            tick = 0;
+            ids = idCheckpoint(ids.resource());
+            for (archetypeCheckpoint& arch : archetypes) {
+                arch = archetypeCheckpoint(arch.resource());
+            }
+        }
+
+        checkpointid id = NULL_CHECKPOINT;
+        uint32_t tick = 0; // Change tick taken at capture
+        idCheckpoint ids;
+        std::array<archetypeCheckpoint, N_ARCHETYPES> archetypes;
+    };
+
+    const worldCheckpoint* findCheckpoint(checkpointid id) const {
+        const worldCheckpoint& checkpoint = _checkpoints[id % _checkpoints.size()];
+        return id != NULL_CHECKPOINT && checkpoint.id == id ? &checkpoint : nullptr;
+    }
+
+    void clearCheckpoints() {
+        for (worldCheckpoint& checkpoint : _checkpoints) {
+            checkpoint.reset();
+        }
+    }
+
+    template<typename ...C>
+    static uint64_t hashComponents(uint64_t hash, std::tuple<C...>*) {
+        hash = hashValue(sizeof...(C), hash);
+        ((hash = hashValue(alignof(C), hashValue(sizeof(C), hashBytes(typeName<C>(), hash)))), ...);
+        return hash;
+    }
+
+    template<size_t Index>
+    using archetypeAt = std::tuple_element_t<Index, std::tuple<Archetypes...>>;
+
+    template<typename Archetype, typename ...C>
+    static constexpr bool hasAllOf(std::tuple<C...>*) {
+        return Archetype::template hasComponents<C...>();
+    }
+
+    // Index of the first archetype holding exactly Src's components plus Added
+    // (or minus Removed). N_ARCHETYPES when no such archetype is registered.
+    template<typename Src, typename Added, size_t Index = 0>
+    static constexpr size_t addTarget() {
+        if constexpr (Index == N_ARCHETYPES || Src::template hasComponent<Added>()) {
+            return N_ARCHETYPES;
+        } else {
+            using Dst = archetypeAt<Index>;
+            if constexpr (Dst::N_COMPONENTS == Src::N_COMPONENTS + 1 &&
+                          Dst::template hasComponent<Added>() &&
+                          hasAllOf<Dst>(static_cast<typename Src::componentTuple*>(nullptr))) {
+                return Index;
+            } else {
+                return addTarget<Src, Added, Index + 1>();
+            }
+        }
+    }
+
+    template<typename Src, typename Removed, size_t Index = 0>
+    static constexpr size_t removeTarget() {
+        if constexpr (Index == N_ARCHETYPES || !Src::template hasComponent<Removed>()) {
+            return N_ARCHETYPES;
+        } else {
+            using Dst = archetypeAt<Index>;
+            if constexpr (Dst::N_COMPONENTS + 1 == Src::N_COMPONENTS &&
+                          !Dst::template hasComponent<Removed>() &&
+                          hasAllOf<Src>(static_cast<typename Dst::componentTuple*>(nullptr))) {
+                return Index;
+            } else {
+                return removeTarget<Src, Removed, Index + 1>();
+            }
+        }
+    }
+
+    template<typename Archetype, typename Component>
+    static constexpr bool storedAsSoa() {
+        if constexpr (Archetype::template hasComponent<Component>()) {
+            return !std::is_reference_v<typename Archetype::template componentRef<Component>>;
+        } else {
+            return false;
+        }
+    }
+
+    // Result of the archetype-agnostic getComponent: a plain reference unless
+    // some archetype splits Component into fields.
+    template<typename Component>
+    using componentRef = std::conditional_t<(storedAsSoa<Archetypes, Component>() || ...),
+                                            soaRef<Component>, Component&>;
+
+    template<typename Component, size_t Index>
+    static constexpr auto componentGetter() {
+        using getter = componentRef<Component> (*)(ecs&, entityid);
+        using Arch = archetypeAt<Index>;
+        if constexpr (Arch::template hasComponent<Component>()) {
+            return getter([](ecs& world, entityid id) -> componentRef<Component> {
+                auto& arch = std::get<Arch>(world._archetypes);
+                archetypeid row = world._idManager.record(id).localId;
+                arch.template markChanged<Component>(row, world.currentWindow().tick);
+                return arch.template getComponentAt<Component>(row);
+            });
+        } else {
+            return getter(nullptr);
+        }
+    }
+
+    template<typename Component>
+    static constexpr auto componentGetters = []<size_t... I>(std::index_sequence<I...>) {
+        return std::array{componentGetter<Component, I>()...};
+    }(std::make_index_sequence<N_ARCHETYPES>{});
+
+    template<typename Component, size_t SrcIndex>
+    static constexpr auto addEdge() {
+        using mover = void (*)(ecs&, entityid, Component&&);
+        constexpr size_t dstIndex = addTarget<archetypeAt<SrcIndex>, Component>();
+        if constexpr (dstIndex < N_ARCHETYPES) {
+            return mover([](ecs& world, entityid id, Component&& value) {
+                world.template moveEntity<SrcIndex, dstIndex>(id, std::move(value));
+            });
+        } else {
+            return mover(nullptr);
+        }
+    }
+
+    template<typename Component, size_t SrcIndex>
+    static constexpr auto removeEdge() {
+        using mover = void (*)(ecs&, entityid);
+        constexpr size_t dstIndex = removeTarget<archetypeAt<SrcIndex>, Component>();
+        if constexpr (dstIndex < N_ARCHETYPES) {
+            return mover([](ecs& world, entityid id) {
+                world.template moveEntity<SrcIndex, dstIndex>(id);
+            });
+        } else {
+            return mover(nullptr);
+        }
+    }
+
+    // Move an entity's row between archetypes. Shared columns are moved over,
+    // `added` (if any) fills the one column the source does not have.
+    template<size_t SrcIndex, size_t DstIndex, typename ...Added>
+    void moveEntity(entityid id, Added&&... added) {
+        using Src = archetypeAt<SrcIndex>;
+        using Dst = archetypeAt<DstIndex>;
+        auto& src = std::get<Src>(_archetypes);
+        auto& dst = std::get<Dst>(_archetypes);
+        archetypeid srcRow = _idManager.record(id).localId;
+
+        auto take = [&]<typename C>(std::type_identity<C>) -> decltype(auto) {
+            if constexpr (storedAsSoa<Src, C>()) {
+                return C(src.template getComponentAt<C>(srcRow));
+            } else if constexpr (Src::template hasComponent<C>()) {
+                return std::move(src.template getComponentAt<C>(srcRow));
+            } else {
+                return C(std::forward<Added>(added)...);
+            }
+        };
+
+        archetypeid localId = [&]<typename ...C>(std::tuple<C...>*) {
+            return dst.addEntity(id, take(std::type_identity<C>{})...);
+        }(static_cast<typename Dst::componentTuple*>(nullptr));
+
+        // Only the new component counts as added; shared ones keep their ticks.
+        dst.markAdded(localId, 1, currentWindow().tick);
+        [&]<typename ...C>(std::tuple<C...>*) {
+            ([&] {
+                if constexpr (Src::template hasComponent<C>()) {
+                    dst.template setAddedTick<C>(localId, src.template addedTick<C>(srcRow));
+                }
+            }(), ...);
+        }(static_cast<typename Dst::componentTuple*>(nullptr));
+
+        removeFromArchetype(srcRow, SrcIndex);
+        EntityRecord& record = _idManager.record(id);
+        record.archetypeIndex = DstIndex;
+        record.localId = localId;
+        profileChanges(1);
+    }
+
+    // Runtime dispatch to remove a row from archetype by index.
+    // The ecs back-patches the record of the entity swapped into the hole.
     template<size_t Index = 0>
-    void removeFromArchetype(entityid id, size_t archetypeIdx) {
+    void removeFromArchetype(archetypeid row, size_t archetypeIdx) {
         if constexpr (Index < N_ARCHETYPES) {
             if (Index == archetypeIdx) {
                 using ArchetypeType = std::tuple_element_t<Index, std::tuple<Archetypes...>>;
-                std::get<ArchetypeType>(_archetypes).removeEntity(id);
+                entityid moved = std::get<ArchetypeType>(_archetypes).removeRow(row);
+                if (moved != NULL_ID) {
+                    _idManager.record(moved).localId = row;
+                }
             } else {
-                removeFromArchetype<Index + 1>(id, archetypeIdx);
+                removeFromArchetype<Index + 1>(row, archetypeIdx);
             }
         }
     }
 
-    idManager _idManager;
-    std::vector<EntityRecord> _entityRecords;  // Global entity ID -> archetype location
+    statsResource _memory;                     // Counts everything allocated through the world's resource
+    idManager _idManager;                      // Entity handles + records (archetype location)
     std::tuple<Archetypes...> _archetypes;     // All archetype instances
     std::vector<std::unique_ptr<SystemBase>> _systems;  // Registered systems
+    std::pmr::vector<uint32_t> _systemProfileIds{&_memory}; // Profiler id per registered system
+    uint32_t _profileSystems = 0;                       // Profiler ids handed out (registered + pipeline)
+
+    threadPool _threadPool;            // Workers for parallel iteration
+    size_t _parallelGrainSize = 0;     // Rows per parallel range, 0 = derive from component sizes
+
+    // System scheduling
+    struct systemNode {
+        uint32_t firstSuccessor = 0; // Systems that must wait for this one, in _successors
+        uint32_t successorCount = 0;
+        uint32_t predecessors = 0;
+    };
+    std::pmr::vector<systemNode> _schedule{&_memory};
+    std::pmr::vector<uint32_t> _successors{&_memory};
+    std::pmr::vector<uint32_t> _remaining{&_memory}; // Unfinished predecessors during a step (atomic_ref)
+    std::atomic<size_t>* _stepPending = nullptr;
+    float _stepDt = 0.0f;
+    bool _scheduleDirty = true;
+    bool _parallelSystems = true;
+
+    // Deferred structural changes, one buffer per pool thread
+    std::pmr::vector<commandBuffer<Archetypes...>> _commandBuffers{&_memory};
+    std::pmr::vector<entityid> _pendingIds{&_memory};           // Flush scratch
+    std::pmr::vector<entityid> _bulkIds{&_memory};              // Bulk create scratch
+    std::array<std::pmr::vector<archetypeid>, N_ARCHETYPES> _pendingRows = // Flush scratch
+        [this]<size_t... I>(std::index_sequence<I...>) {
+            return std::array<std::pmr::vector<archetypeid>, N_ARCHETYPES>{((void)I, std::pmr::vector<archetypeid>(&_memory))...};
+        }(std::make_index_sequence<N_ARCHETYPES>{});
+
+    std::atomic<uint32_t> _changeTick{0}; // Change detection clock, see updateSystem
+
+    // Channels by eventId in pages of EVENT_PAGE_SLOTS, both null until first use
+    using eventPage = std::array<std::atomic<eventChannelBase*>, EVENT_PAGE_SLOTS>;
+    std::array<std::atomic<eventPage*>, MAX_EVENT_TYPES / EVENT_PAGE_SLOTS> _eventPages{};
+    std::pmr::vector<eventChannelPtr> _ownedChannels{&_memory};
+    std::mutex _eventMutex; // Channel creation
+
+    // Rollback ring, slot = id % capacity
+    std::pmr::vector<worldCheckpoint> _checkpoints{&_memory};
+    checkpointid _lastCheckpoint = NULL_CHECKPOINT;
+
+    profiler _profiler;   // Ring buffer of step/flush/system timings
+    uint64_t _frame = 0;
 
     // ECS should maintain their own internal timesteps in seconds.
     std::chrono::time_point<std::chrono::steady_clock> _lastUpdate;
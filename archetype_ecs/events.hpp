@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace gxe {
+
+// Typed event channels owned by the ecs (see ecs::events). Events sent during
+// a step are read during the next one, so producers and consumers never wait
+// on each other and both may run in parallel systems:
+//   world.events<Collision>().send(Collision{a, b});            // Any thread
+//   for (const Collision& c : world.events<Collision>().read()) // Whole batch
+// Every reader sees every event; an event is gone after one step.
+
+// Swapped by the ecs at the end of every step, when no system is running.
+class eventChannelBase {
+public:
+    virtual ~eventChannelBase() = default;
+    virtual void swap() = 0;
+};
+
+// Runtime id per event type, indexing the ecs' channel table. Ids are
+// process wide: every ecs (of any type) sees the same id for an event type.
+inline std::atomic<uint32_t> nextEventId{0};
+
+template<typename Event>
+uint32_t eventId() {
+    static const uint32_t id = nextEventId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+// Two fixed-size buffers: senders claim slots of the write buffer with one
+// atomic add, readers see the read buffer. Sends past the capacity go to a
+// locked spill list and the buffers grow at the next swap to hold the peak,
+// so once warmed up a step sends and reads without allocating or locking.
+template<typename Event>
+class eventChannel final : public eventChannelBase {
+    static_assert(std::is_trivially_copyable_v<Event> && std::is_default_constructible_v<Event>,
+                  "Events must be plain data");
+
+public:
+    eventChannel(size_t capacity, std::pmr::memory_resource* resource)
+        : _buffers{buffer(capacity, resource), buffer(capacity, resource)}
+        , _spill(resource) {}
+
+    void send(const Event& event) {
+        size_t slot = _sent.fetch_add(1, std::memory_order_relaxed);
+        if (slot < _write->size()) {
+            (*_write)[slot] = event;
+        } else {
+            spill(std::span<const Event>(&event, 1));
+        }
+    }
+
+    // Claim room for the whole batch at once.
+    void send(std::span<const Event> events) {
+        size_t first = _sent.fetch_add(events.size(), std::memory_order_relaxed);
+        size_t fit = first < _write->size() ? std::min(events.size(), _write->size() - first) : 0;
+        if (fit > 0) {
+            std::copy_n(events.begin(), fit, _write->data() + first);
+        }
+        if (fit < events.size()) {
+            spill(events.subspan(fit));
+        }
+    }
+
+    // Events sent during the previous step.
+    std::span<const Event> read() const {
+        return std::span<const Event>(_read->data(), _readCount);
+    }
+
+    size_t capacity() const { return _write->size(); }
+
+    void swap() override {
+        size_t sent = std::min(_sent.load(std::memory_order_relaxed), _write->size());
+        std::swap(_read, _write);
+        _readCount = sent;
+        if (!_spill.empty()) {
+            // Overflowed: append the spill and grow the other buffer to match.
+            _read->resize(sent + _spill.size());
+            std::copy(_spill.begin(), _spill.end(), _read->begin() + sent);
+            _readCount += _spill.size();
+            _spill.clear();
+        }
+        if (_write->size() < _read->size()) {
+            _write->resize(_read->size());
+        }
+        _sent.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    using buffer = std::pmr::vector<Event>;
+
+    void spill(std::span<const Event> events) {
+        std::lock_guard lock(_spillMutex);
+        _spill.insert(_spill.end(), events.begin(), events.end());
+    }
+
+    buffer _buffers[2];
+    buffer* _write = &_buffers[0];
+    buffer* _read = &_buffers[1];
+    size_t _readCount = 0;
+    std::atomic<size_t> _sent{0}; // Slots claimed in the write buffer this step
+
+    std::mutex _spillMutex;
+    buffer _spill; // Sends that found the write buffer full
+};
+
+// Owning pointer to a channel allocated from a memory resource.
+struct eventChannelDeleter {
+    std::pmr::memory_resource* resource;
+    void (*destroy)(std::pmr::memory_resource* resource, eventChannelBase* channel);
+
+    void operator()(eventChannelBase* channel) const {
+        destroy(resource, channel);
+    }
+};
+
+using eventChannelPtr = std::unique_ptr<eventChannelBase, eventChannelDeleter>;
+
+// Channel and its buffers both come from resource.
+template<typename Event>
+eventChannelPtr makeEventChannel(size_t capacity, std::pmr::memory_resource* resource) {
+    std::pmr::polymorphic_allocator<> alloc(resource);
+    auto destroy = [](std::pmr::memory_resource* r, eventChannelBase* channel) {
+        std::pmr::polymorphic_allocator<>(r).delete_object(static_cast<eventChannel<Event>*>(channel));
+    };
+    return eventChannelPtr(alloc.new_object<eventChannel<Event>>(capacity, resource), eventChannelDeleter{resource, destroy});
+}
+
+} // namespace gxe
@@ -1,46 +1,221 @@
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 
 #include "idManager.hpp"
 
 namespace gxe {
 
-const uint32_t INITIAL_ENTITY_LIMIT = INITIAL_SPARSE_SET_CAPACITY; // Set an initial entity limit of 1024 entities.
-const entityid INITIAL_ENTITY_ID = 0;
+idManager::idManager(std::pmr::memory_resource* resource)
+    : _resource(resource), _pages(resource), _pageVersions(resource), _freeHead(NULL_ID), _freeTail(NULL_ID), _numEntities(0) {}
 
-idManager::idManager() : _numEntities(0) {
-    allocateEntities(INITIAL_ENTITY_ID);
+idManager::~idManager(){
+    for(EntityRecord* page : _pages){
+        _resource->deallocate(page, PAGE_SLOTS * sizeof(EntityRecord), alignof(EntityRecord));
+    }
 }
 
-entityid idManager::createEntity(){
-    // Pop the back of available.
-    entityid id = _availableIds.back();
-    _availableIds.pop_back();
+void idManager::resize(size_t slots){
+    // Pages are kept when shrinking, with every record past the end reset so
+    // that growing again hands out fresh records.
+    for(size_t index = slots; index < _slots; ++index){
+        slot(static_cast<entityid>(index)) = EntityRecord();
+    }
+    while(_pages.size() * PAGE_SLOTS < slots){
+        auto* page = static_cast<EntityRecord*>(_resource->allocate(PAGE_SLOTS * sizeof(EntityRecord), alignof(EntityRecord)));
+        std::uninitialized_value_construct_n(page, PAGE_SLOTS);
+        _pages.push_back(page);
+    }
+    _slots = slots;
+}
 
-    if(_availableIds.empty()){
-        allocateEntities(id);
+entityid idManager::createEntity(){
+    entityid index;
+    if(_freeHead != NULL_ID){
+        // Pop the front of the free list.
+        index = _freeHead;
+        _freeHead = slot(index).localId;
+        if(_freeHead == NULL_ID){
+            _freeTail = NULL_ID;
+        }
+    } else {
+        // No free slot, grow the directory by one.
+        assert(_slots <= MAX_ENTITY_INDEX && "Entity index space exhausted");
+        index = static_cast<entityid>(_slots);
+        resize(_slots + 1);
     }
 
+    EntityRecord& record = slot(index);
+    record.localId = NULL_ARCHETYPE_ID;
+    touchSlot(index);
+
     _numEntities++;
-    return id;
+    return makeEntityId(index, record.generation);
+}
+
+void idManager::createEntities(std::span<entityid> out){
+    size_t i = 0;
+
+    // Reuse free slots first.
+    for(; i < out.size() && _freeHead != NULL_ID; ++i){
+        out[i] = createEntity();
+    }
+
+    // Then grow the directory in one step.
+    size_t remaining = out.size() - i;
+    if(remaining > 0){
+        assert(_slots + remaining <= size_t(MAX_ENTITY_INDEX) + 1 && "Entity index space exhausted");
+        entityid firstIndex = static_cast<entityid>(_slots);
+        resize(_slots + remaining);
+        for(size_t k = 0; k < remaining; ++k){
+            out[i + k] = makeEntityId(firstIndex + static_cast<entityid>(k), 0);
+        }
+        for(size_t index = firstIndex; index < _slots; index += PAGE_SLOTS){
+            touchSlot(static_cast<entityid>(index));
+        }
+        touchSlot(static_cast<entityid>(_slots - 1));
+        _numEntities += static_cast<uint32_t>(remaining);
+    }
 }
 
 // We want Id's to be reused in the potential
 // case that we delete and spawn entities in vast quantities.
+// Bumping the generation makes every outstanding handle to the slot stale.
 void idManager::destroyEntity(entityid id){
-    _availableIds.push_back(id);
+    assert(isAlive(id) && "Destroying a stale entity handle");
+
+    entityid index = entityIndex(id);
+    EntityRecord& record = slot(index);
+    record.archetypeIndex = NULL_ARCHETYPE_INDEX;
+    record.localId = NULL_ID;
+    record.generation++;
+    touchSlot(index);
+
+    // Append to the back of the free list.
+    if(_freeTail != NULL_ID){
+        slot(_freeTail).localId = index;
+        touchSlot(_freeTail);
+    } else {
+        _freeHead = index;
+    }
+    _freeTail = index;
+
     _numEntities--;
 }
 
-void idManager::allocateEntities(entityid startId){
-    entityid endId = startId + INITIAL_ENTITY_LIMIT;
-    _availableIds.reserve(_availableIds.size() + INITIAL_ENTITY_LIMIT);
+void idManager::clear(){
+    resize(0);
+    _pageVersions.assign(_pageVersions.size(), ++_version);
+    _freeHead = NULL_ID;
+    _freeTail = NULL_ID;
+    _numEntities = 0;
+}
+
+void idManager::save(snapshotWriter& out) const {
+    out.value(static_cast<uint64_t>(_slots));
+    out.value(_freeHead);
+    out.value(_freeTail);
+    out.value(_numEntities);
+    out.align();
+    for(size_t page = 0; page < pageCount(); ++page){
+        out.write(_pages[page], pageSlots(page) * sizeof(EntityRecord));
+    }
+}
+
+bool idManager::load(snapshotReader& in){
+    uint64_t count = 0;
+    entityid freeHead = NULL_ID, freeTail = NULL_ID;
+    uint32_t numEntities = 0;
+    if(!in.value(count) || !in.value(freeHead) || !in.value(freeTail) || !in.value(numEntities)){
+        return false;
+    }
+    if(count > size_t(MAX_ENTITY_INDEX) + 1 || numEntities > count){
+        return false;
+    }
+
+    std::span<const EntityRecord> records = in.array<EntityRecord>(count);
+    if(!in.ok()){
+        return false;
+    }
+    clear();
+    resize(count);
+    for(size_t page = 0; page < pageCount(); ++page){
+        std::memcpy(static_cast<void*>(_pages[page]), records.data() + page * PAGE_SLOTS, pageSlots(page) * sizeof(EntityRecord));
+    }
+    _pageVersions.assign(pageCount(), ++_version);
+    _freeHead = freeHead;
+    _freeTail = freeTail;
+    _numEntities = numEntities;
+    if(!consistent()){
+        clear();
+        return false;
+    }
+    return true;
+}
+
+// Every slot is either live or on the free list, exactly once, and the live
+// count matches. Archetype locations are checked by the ecs, which knows them.
+bool idManager::consistent() const {
+    size_t live = 0;
+    for(size_t index = 0; index < _slots; ++index){
+        live += slot(static_cast<entityid>(index)).isValid();
+    }
+    if(live != _numEntities){
+        return false;
+    }
 
-    for(entityid i = endId - 1; i >= startId; i--){
-        _availableIds.emplace_back(i);
-        [[unlikely]] if(i == 0){
-            break;
+    // Walk the free list: at most one step per free slot, so a cycle fails too.
+    size_t free = _slots - live;
+    size_t visited = 0;
+    entityid last = NULL_ID;
+    for(entityid index = _freeHead; index != NULL_ID; index = slot(index).localId){
+        if(visited == free || index >= _slots || slot(index).isValid()){
+            return false;
         }
+        last = index;
+        ++visited;
     }
+    return visited == free && last == _freeTail;
+}
+
+void idManager::checkpoint(idCheckpoint& out, const idCheckpoint* previous){
+    out.slots = _slots;
+    out.freeHead = _freeHead;
+    out.freeTail = _freeTail;
+    out.numEntities = _numEntities;
+    out.version = _version++;
+
+    size_t pages = pageCount();
+    _pageVersions.resize(pages);
+    out.pages.resize(pages);
+    for(size_t page = 0; page < pages; ++page){
+        bool shared = previous && page < previous->pages.size() && _pageVersions[page] <= previous->version;
+        if(shared){
+            out.pages[page] = previous->pages[page];
+        } else {
+            out.pages[page] = copyToBuffer(_pages[page], pageSlots(page) * sizeof(EntityRecord), out.resource());
+        }
+    }
+}
+
+void idManager::restore(const idCheckpoint& checkpoint){
+    size_t pages = checkpoint.pages.size();
+    size_t livePages = pageCount();
+    resize(checkpoint.slots);
+    _pageVersions.resize(pages);
+
+    for(size_t page = 0; page < pages; ++page){
+        // Pages that grew or changed since the checkpoint are copied back.
+        if(page + 1 >= livePages || _pageVersions[page] > checkpoint.version){
+            std::memcpy(static_cast<void*>(_pages[page]), checkpoint.pages[page].get(), pageSlots(page) * sizeof(EntityRecord));
+            _pageVersions[page] = _version;
+        }
+    }
+
+    _freeHead = checkpoint.freeHead;
+    _freeTail = checkpoint.freeTail;
+    _numEntities = checkpoint.numEntities;
 }
 
-} // namespace gxe
\ No newline at end of file
+} // namespace gxe
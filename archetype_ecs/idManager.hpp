@@ -1,26 +1,134 @@
 #pragma once
 
+#include "checkpoint.hpp"
+#include "snapshot.hpp"
 #include "types.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <memory_resource>
+#include <span>
 #include <vector>
 
 namespace gxe {
 
+// Location of a live entity, packed into 8 bytes. While a slot is free,
+// localId links to the next free slot instead (intrusive free list).
+struct EntityRecord {
+    archetypeid localId;           // Index within the archetype's component arrays
+    archetypeindex archetypeIndex; // Position in the ecs archetype list
+    uint8_t generation;            // Generation of the handle currently owning this slot
+
+    EntityRecord()
+        : localId(NULL_ARCHETYPE_ID)
+        , archetypeIndex(NULL_ARCHETYPE_INDEX)
+        , generation(0) {}
+
+    bool isValid() const {
+        return archetypeIndex != NULL_ARCHETYPE_INDEX;
+    }
+};
+
+static_assert(sizeof(EntityRecord) == 8, "EntityRecord should pack into 8 bytes");
+
+// Entity directory: hands out generational handles and owns their records.
+// Records sit in fixed-size pages (DIRECTORY_PAGE_SLOTS) allocated on demand,
+// so growing never moves a record and a lookup is one page-table hop.
 class idManager {
 public:
-    idManager();
-    ~idManager() = default;
+    explicit idManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    ~idManager();
+
+    idManager(const idManager&) = delete;
+    idManager& operator=(const idManager&) = delete;
 
-    entityid createEntity(); // Return an id, and remove it from availableEntities
-    void destroyEntity(entityid id);
+    entityid createEntity(); // Return a handle to a free slot
+    void createEntities(std::span<entityid> out); // Fill out with new handles, growing the directory once
+    void destroyEntity(entityid id); // Free the slot and invalidate outstanding handles
+    void clear(); // Forget every entity, keeping the pages
+
+    // True if id is the current handle of a live slot. A free slot keeps its
+    // generation, which a wrapped or rolled back handle can match, so the
+    // record must be in use too.
+    bool isAlive(entityid id) const {
+        entityid index = entityIndex(id);
+        return index < _slots && slot(index).isValid() && slot(index).generation == entityGeneration(id);
+    }
+
+    EntityRecord& record(entityid id) {
+        assert(entityIndex(id) < _slots && "Invalid entity ID");
+        return slot(entityIndex(id));
+    }
+
+    const EntityRecord& record(entityid id) const {
+        assert(entityIndex(id) < _slots && "Invalid entity ID");
+        return slot(entityIndex(id));
+    }
 
     int entityCount() const { return _numEntities; };
 
+    // Snapshot the directory (records, free list, live count) / replace it
+    // from a snapshot. load returns false, leaving the directory empty, on
+    // truncated data or a broken free list or live count.
+    void save(snapshotWriter& out) const;
+    bool load(snapshotReader& in);
+
+    // Upper bound of the bytes save() writes.
+    size_t snapshotBytes() const {
+        return 3 * SNAPSHOT_ALIGNMENT + _slots * sizeof(EntityRecord);
+    }
+
+    // Rollback support (see checkpoint.hpp). Only slots handed out or freed
+    // bump their page's version; archetype/row locations written by the ecs are
+    // restored from the archetypes instead.
+    void checkpoint(idCheckpoint& out, const idCheckpoint* previous);
+    void restore(const idCheckpoint& checkpoint);
+
 private:
-    void allocateEntities(entityid startID);
-    std::vector<entityid> _availableIds; // Treat as stack for uniqueID's.
+    static constexpr size_t PAGE_SLOTS = DIRECTORY_PAGE_SLOTS;
+
+    EntityRecord& slot(entityid index) {
+        return _pages[index / PAGE_SLOTS][index % PAGE_SLOTS];
+    }
+
+    const EntityRecord& slot(entityid index) const {
+        return _pages[index / PAGE_SLOTS][index % PAGE_SLOTS];
+    }
+
+    // Records in use on page (the last page may be partly used).
+    size_t pageSlots(size_t page) const {
+        return std::min(PAGE_SLOTS, _slots - page * PAGE_SLOTS);
+    }
+
+    size_t pageCount() const {
+        return (_slots + PAGE_SLOTS - 1) / PAGE_SLOTS;
+    }
+
+    bool consistent() const; // Free list and live count agree with the records
+
+    // Grow (allocating pages) or shrink (resetting the dropped records) to slots.
+    void resize(size_t slots);
+
+    void touchSlot(entityid index) {
+        size_t page = index / PAGE_SLOTS;
+        if (page >= _pageVersions.size()) {
+            _pageVersions.resize(page + 1);
+        }
+        _pageVersions[page] = _version;
+    }
+
+    std::pmr::memory_resource* _resource;
+    std::pmr::vector<EntityRecord*> _pages;  // Slot index / PAGE_SLOTS -> page, never moved
+    size_t _slots = 0;                       // Slots handed out so far
+    std::pmr::vector<uint64_t> _pageVersions; // Per PAGE_SLOTS records: version of the last slot change
+    uint64_t _version = 1;
+
+    // FIFO free list threaded through free records, so a slot is reused (and
+    // its generation wraps) as late as possible.
+    entityid _freeHead;
+    entityid _freeTail;
 
     uint32_t _numEntities;
 };
 
-}
\ No newline at end of file
+}
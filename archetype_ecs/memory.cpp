@@ -0,0 +1,140 @@
+#include "memory.hpp"
+
+#include <cstdint>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define GXE_HAS_MMAP 1
+#else
+#define GXE_HAS_MMAP 0
+#endif
+
+namespace gxe {
+
+namespace {
+std::size_t roundUp(std::size_t value, std::size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+}
+
+memoryStats statsResource::stats() const {
+    return memoryStats{
+        _allocations.load(std::memory_order_relaxed),
+        _deallocations.load(std::memory_order_relaxed),
+        _bytesAllocated.load(std::memory_order_relaxed),
+        _bytesInUse.load(std::memory_order_relaxed),
+        _peakBytes.load(std::memory_order_relaxed)
+    };
+}
+
+void* statsResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* ptr = _upstream->allocate(bytes, alignment);
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    _bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t inUse = _bytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = _peakBytes.load(std::memory_order_relaxed);
+    while (inUse > peak && !_peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {
+    }
+    return ptr;
+}
+
+void statsResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) {
+    _upstream->deallocate(ptr, bytes, alignment);
+    _deallocations.fetch_add(1, std::memory_order_relaxed);
+    _bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+arenaResource::arenaResource(std::size_t capacity, std::pmr::memory_resource* upstream)
+    : _upstream(upstream)
+    , _block(static_cast<std::byte*>(upstream->allocate(capacity, BLOCK_ALIGNMENT)))
+    , _capacity(capacity) {}
+
+arenaResource::~arenaResource() {
+    _upstream->deallocate(_block, _capacity, BLOCK_ALIGNMENT);
+}
+
+std::size_t arenaResource::used() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _used;
+}
+
+void arenaResource::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _used = 0;
+}
+
+void* arenaResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uintptr_t base = reinterpret_cast<uintptr_t>(_block);
+        std::size_t offset = roundUp(base + _used, alignment) - base;
+        if (offset <= _capacity && bytes <= _capacity - offset) {
+            _used = offset + bytes;
+            return _block + offset;
+        }
+    }
+    return _upstream->allocate(bytes, alignment);
+}
+
+void arenaResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) {
+    std::byte* p = static_cast<std::byte*>(ptr);
+    if (p >= _block && p < _block + _capacity) {
+        return;
+    }
+    _upstream->deallocate(ptr, bytes, alignment);
+}
+
+bool hugePageResource::mapped(std::size_t bytes, std::size_t alignment) const {
+    return GXE_HAS_MMAP && bytes >= _threshold && alignment <= HUGE_PAGE_BYTES;
+}
+
+void* hugePageResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    if (!mapped(bytes, alignment)) {
+        return _upstream->allocate(bytes, alignment);
+    }
+#if GXE_HAS_MMAP
+    std::size_t size = roundUp(bytes, HUGE_PAGE_BYTES);
+#ifdef MAP_HUGETLB
+    if (_tryHugetlb.load(std::memory_order_relaxed)) {
+        void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            return ptr;
+        }
+        _tryHugetlb.store(false, std::memory_order_relaxed);
+    }
+#endif
+    // Over-map by one huge page and trim, so the range is huge page aligned.
+    std::size_t span = size + HUGE_PAGE_BYTES;
+    void* raw = ::mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    std::byte* begin = static_cast<std::byte*>(raw);
+    std::byte* aligned = begin + (roundUp(reinterpret_cast<uintptr_t>(raw), HUGE_PAGE_BYTES) - reinterpret_cast<uintptr_t>(raw));
+    if (aligned > begin) {
+        ::munmap(begin, static_cast<std::size_t>(aligned - begin));
+    }
+    if (aligned + size < begin + span) {
+        ::munmap(aligned + size, static_cast<std::size_t>(begin + span - (aligned + size)));
+    }
+#ifdef MADV_HUGEPAGE
+    ::madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+#else
+    return nullptr;
+#endif
+}
+
+void hugePageResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) {
+    if (!mapped(bytes, alignment)) {
+        _upstream->deallocate(ptr, bytes, alignment);
+        return;
+    }
+#if GXE_HAS_MMAP
+    ::munmap(ptr, roundUp(bytes, HUGE_PAGE_BYTES));
+#endif
+}
+
+} // namespace gxe
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+
+namespace gxe {
+
+// Memory resources for world storage. An ecs takes any std::pmr::memory_resource
+// and routes component columns, entity records and per-step scratch through it:
+//   gxe::hugePageResource pages;
+//   gxe::arenaResource arena(256 << 20, &pages); // One up-front block in huge pages
+//   World world(threads, &arena);
+// Resources handed to an ecs must be thread safe; every one below is.
+
+struct memoryStats {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t bytesAllocated = 0; // Total requested over the lifetime
+    uint64_t bytesInUse = 0;
+    uint64_t peakBytes = 0;
+};
+
+// Forwards to an upstream resource and counts the traffic. Every ecs wraps its
+// resource in one, see ecs::memoryUsage.
+class statsResource : public std::pmr::memory_resource {
+public:
+    explicit statsResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : _upstream(upstream) {}
+
+    memoryStats stats() const;
+    std::pmr::memory_resource* upstream() const { return _upstream; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* _upstream;
+    std::atomic<uint64_t> _allocations{0};
+    std::atomic<uint64_t> _deallocations{0};
+    std::atomic<uint64_t> _bytesAllocated{0};
+    std::atomic<uint64_t> _bytesInUse{0};
+    std::atomic<uint64_t> _peakBytes{0};
+};
+
+// Bump allocator over one block taken from upstream up front (size it for a
+// level's worth of entities). Freed memory is only reclaimed by reset();
+// requests that no longer fit go to upstream.
+class arenaResource : public std::pmr::memory_resource {
+public:
+    explicit arenaResource(std::size_t capacity, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~arenaResource() override;
+
+    arenaResource(const arenaResource&) = delete;
+    arenaResource& operator=(const arenaResource&) = delete;
+
+    std::size_t capacity() const { return _capacity; }
+    std::size_t used() const;
+
+    // Start over from the beginning of the block. Nothing allocated from the
+    // block may still be in use.
+    void reset();
+
+private:
+    static constexpr std::size_t BLOCK_ALIGNMENT = 4096;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* _upstream;
+    std::byte* _block;
+    std::size_t _capacity;
+    std::size_t _used = 0;
+    mutable std::mutex _mutex;
+};
+
+// Requests of at least `threshold` bytes are mapped directly in whole huge
+// pages: MAP_HUGETLB when the system has reserved huge pages, otherwise a
+// HUGE_PAGE_BYTES aligned mapping advised for transparent huge pages. Smaller
+// requests (and every request where mmap is unavailable) go upstream.
+class hugePageResource : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t HUGE_PAGE_BYTES = std::size_t(2) << 20;
+
+    explicit hugePageResource(std::size_t threshold = HUGE_PAGE_BYTES / 2,
+                              std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : _threshold(threshold), _upstream(upstream) {}
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    bool mapped(std::size_t bytes, std::size_t alignment) const;
+
+    std::size_t _threshold;
+    std::pmr::memory_resource* _upstream;
+    std::atomic<bool> _tryHugetlb{true}; // Cleared once MAP_HUGETLB fails
+};
+
+// Size-class pools that keep freed blocks for reuse, so buffers recreated
+// every step (task lists, queue nodes) stop reaching upstream once warm.
+class poolResource : public std::pmr::synchronized_pool_resource {
+public:
+    static constexpr std::size_t LARGEST_POOLED_BLOCK = std::size_t(1) << 20;
+
+    explicit poolResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : std::pmr::synchronized_pool_resource(std::pmr::pool_options{0, LARGEST_POOLED_BLOCK}, upstream) {}
+};
+
+} // namespace gxe
@@ -0,0 +1,135 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+
+namespace gxe {
+
+namespace {
+double toUs(int64_t ns) {
+    return double(ns) / 1000.0;
+}
+
+// Nearest-rank percentile of sorted durations
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * double(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void writeEscaped(std::ostream& out, std::string_view text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+}
+}
+
+profiler::profiler(size_t capacity)
+    : _capacity(capacity > 0 ? capacity : 1)
+    , _events(std::make_unique<profileEvent[]>(_capacity))
+    , _epoch(std::chrono::steady_clock::now()) {}
+
+void profiler::setSystemName(uint32_t system, std::string_view name) {
+    if (_systemNames.size() <= system) {
+        _systemNames.resize(system + 1);
+    }
+    _systemNames[system] = name;
+}
+
+std::string_view profiler::systemName(uint32_t system) const {
+    if (system == profileEvent::STEP) {
+        return "step";
+    }
+    if (system == profileEvent::FLUSH) {
+        return "flushCommands";
+    }
+    if (system < _systemNames.size() && !_systemNames[system].empty()) {
+        return _systemNames[system];
+    }
+    return "system";
+}
+
+std::vector<profileEvent> profiler::events() const {
+    uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, _capacity);
+
+    std::vector<profileEvent> out;
+    out.reserve(count);
+    for (uint64_t i = head - count; i < head; ++i) {
+        out.push_back(_events[i % _capacity]);
+    }
+    return out;
+}
+
+profileStats profiler::stats(uint32_t system) const {
+    profileStats result;
+    std::vector<int64_t> durations;
+    double substeps = 0.0, entities = 0.0, changes = 0.0;
+
+    for (const profileEvent& event : events()) {
+        if (event.system == system) {
+            durations.push_back(event.duration);
+            substeps += event.substeps;
+            entities += double(event.entities);
+            changes += double(event.changes);
+        }
+    }
+    if (durations.empty()) {
+        return result;
+    }
+
+    std::sort(durations.begin(), durations.end());
+    double n = double(durations.size());
+    result.samples = durations.size();
+    result.p50Us = toUs(percentile(durations, 0.50));
+    result.p99Us = toUs(percentile(durations, 0.99));
+    result.maxUs = toUs(durations.back());
+    result.meanSubsteps = substeps / n;
+    result.meanEntities = entities / n;
+    result.meanChanges = changes / n;
+    return result;
+}
+
+void profiler::writeChromeTrace(std::ostream& out) const {
+    std::vector<profileEvent> buffered = events();
+    uint32_t maxThread = 0;
+
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision(3);
+    out << std::fixed;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const profileEvent& event : buffered) {
+        maxThread = std::max(maxThread, event.thread);
+        out << "{\"name\":\"";
+        writeEscaped(out, systemName(event.system));
+        out << "\",\"cat\":\"" << (event.system >= profileEvent::FLUSH ? "ecs" : "system")
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << toUs(event.start) << ",\"dur\":" << toUs(event.duration)
+            << ",\"args\":{\"frame\":" << event.frame << ",\"substeps\":" << event.substeps
+            << ",\"entities\":" << event.entities << ",\"changes\":" << event.changes << "}},\n";
+    }
+    for (uint32_t thread = 0; thread <= maxThread; ++thread) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"" << (thread == 0 ? std::string("main") : "worker " + std::to_string(thread))
+            << "\"}}" << (thread < maxThread ? ",\n" : "\n");
+    }
+    out << "]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool profiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    writeChromeTrace(file);
+    return bool(file);
+}
+
+} // namespace gxe
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Instrumentation switch: build with -DGXE_PROFILE=0 to compile recording out.
+#ifndef GXE_PROFILE
+#define GXE_PROFILE 1
+#endif
+
+namespace gxe {
+
+constexpr inline bool PROFILE_ENABLED = GXE_PROFILE != 0;
+
+// One timed scope: a system update, a command flush or a whole step.
+struct profileEvent {
+    static constexpr uint32_t STEP = UINT32_MAX;      // system value for ecs::step
+    static constexpr uint32_t FLUSH = UINT32_MAX - 1; // system value for flushCommands
+
+    uint32_t system = STEP; // Registration index, or STEP / FLUSH
+    uint32_t thread = 0;    // Pool worker index, 0 = thread driving the ecs
+    uint32_t substeps = 0;  // Fixed-rate ticks run by the update
+    uint64_t frame = 0;
+    int64_t start = 0;      // ns since the profiler was created
+    int64_t duration = 0;   // ns
+    uint64_t entities = 0;  // Rows handed to iteration callbacks
+    uint64_t changes = 0;   // Entities created/destroyed/moved or commands recorded
+};
+
+// Rolling statistics over the events still held by the ring buffer.
+struct profileStats {
+    size_t samples = 0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+    double meanSubsteps = 0.0;
+    double meanEntities = 0.0;
+    double meanChanges = 0.0;
+};
+
+// Fixed-capacity event ring. Recording is lock-free (one atomic increment
+// per event) and may happen from any pool thread; reading and exporting must
+// happen while no step is running. Old events are overwritten.
+class profiler {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    explicit profiler(size_t capacity = DEFAULT_CAPACITY);
+
+    // Runtime switch on top of GXE_PROFILE. On by default.
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return PROFILE_ENABLED && _enabled.load(std::memory_order_relaxed); }
+
+    // ns since construction
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - _epoch).count();
+    }
+
+    void record(const profileEvent& event) {
+        uint64_t slot = _head.fetch_add(1, std::memory_order_relaxed);
+        _events[slot % _capacity] = event;
+    }
+
+    void setSystemName(uint32_t system, std::string_view name);
+    std::string_view systemName(uint32_t system) const;
+
+    size_t capacity() const { return _capacity; }
+
+    // Buffered events, oldest first.
+    std::vector<profileEvent> events() const;
+
+    profileStats stats(uint32_t system) const;
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto, Speedscope).
+    void writeChromeTrace(std::ostream& out) const;
+    bool writeChromeTrace(const std::string& path) const;
+
+    void clear() { _head.store(0, std::memory_order_relaxed); }
+
+private:
+    size_t _capacity;
+    std::unique_ptr<profileEvent[]> _events;
+    std::atomic<uint64_t> _head{0}; // Total events recorded
+    std::atomic<bool> _enabled{true};
+    std::chrono::steady_clock::time_point _epoch;
+    std::vector<std::string> _systemNames;
+};
+
+// Per-thread counters of the innermost open profileScope. Iteration and
+// structural calls bump them; they are no-ops outside a scope.
+struct profileCounters {
+    uint64_t entities = 0;
+    uint64_t changes = 0;
+};
+
+inline thread_local profileCounters* t_profileCounters = nullptr;
+
+inline void profileEntities(size_t count) {
+    if constexpr (PROFILE_ENABLED) {
+        if (t_profileCounters) {
+            t_profileCounters->entities += count;
+        }
+    }
+}
+
+inline void profileChanges(size_t count) {
+    if constexpr (PROFILE_ENABLED) {
+        if (t_profileCounters) {
+            t_profileCounters->changes += count;
+        }
+    }
+}
+
+// Times its lifetime and records one event on destruction. Scopes nest per thread.
+class profileScope {
+public:
+    profileScope(profiler& prof, uint32_t system, uint64_t frame, uint32_t thread)
+        : _profiler(prof.enabled() ? &prof : nullptr) {
+        if (_profiler) {
+            _event.system = system;
+            _event.frame = frame;
+            _event.thread = thread;
+            _parent = t_profileCounters;
+            t_profileCounters = &_counters;
+            _event.start = _profiler->now();
+        }
+    }
+
+    profileScope(const profileScope&) = delete;
+    profileScope& operator=(const profileScope&) = delete;
+
+    ~profileScope() {
+        if (_profiler) {
+            _event.duration = _profiler->now() - _event.start;
+            _event.entities = _counters.entities;
+            _event.changes = _counters.changes;
+            t_profileCounters = _parent;
+            _profiler->record(_event);
+        }
+    }
+
+    void setSubsteps(uint32_t substeps) {
+        _event.substeps = substeps;
+    }
+
+private:
+    profiler* _profiler;
+    profileEvent _event;
+    profileCounters _counters;
+    profileCounters* _parent = nullptr;
+};
+
+// Readable name of a type, e.g. "gxe::PhysicsSystem" (template arguments dropped).
+template<typename T>
+std::string_view typeName() {
+    std::string_view pretty = __PRETTY_FUNCTION__; // "... [with T = Name<...>; ...]" or "... [T = Name<...>]"
+    size_t begin = pretty.find("T = ");
+    if (begin == std::string_view::npos) {
+        return "system";
+    }
+    begin += 4;
+    return pretty.substr(begin, pretty.find_first_of(";]<", begin) - begin);
+}
+
+} // namespace gxe
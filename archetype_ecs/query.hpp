@@ -0,0 +1,156 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <type_traits>
+
+namespace gxe {
+
+// Row filters for iteration, mixed into the component list:
+//   world.forEachWithComponents<const Position, EColor, changed<Position>>(...)
+// Filters restrict which rows are visited but are not passed to the callback.
+//   changed<T>  T was written since the running system last ran (tracked per
+//               block of rows, so unchanged neighbours of a write are visited too)
+//   added<T>    the entity gained T (was created, or moved into an archetype
+//               with T) since the running system last ran
+// Requesting `const T` reads T without marking it changed.
+template<typename T>
+struct changed {};
+
+template<typename T>
+struct added {};
+
+// Archetype-level terms:
+//   with<T...>      group of required terms, same as listing them directly
+//   without<T...>   skip archetypes holding any of T
+//   optional<T...>  pass T* (nullptr where the archetype lacks T) after the
+//                   required components
+// A query bundles terms into a reusable type:
+//   using Movers = query<with<Position, Velocity>, without<Static>, optional<EColor>>;
+//   world.forEachQuery<Movers>([](Position&, Velocity&, EColor* color) { ... });
+template<typename ...Ts>
+struct with {};
+
+template<typename ...Ts>
+struct without {};
+
+template<typename ...Ts>
+struct optional {};
+
+template<typename ...Terms>
+struct query {};
+
+// Change ticks of an iteration: rows count as changed when their tick is
+// greater than `since`; mutable columns are stamped with `tick` (0 = don't stamp).
+struct changeWindow {
+    uint32_t since = 0;
+    uint32_t tick = 0;
+};
+
+template<typename ...Ts>
+struct typeList {};
+
+template<typename T>
+constexpr bool isRowFilter = false;
+
+template<typename T>
+constexpr bool isRowFilter<changed<T>> = true;
+
+template<typename T>
+constexpr bool isRowFilter<added<T>> = true;
+
+// Component named by a query term: const T, changed<T> and added<T> -> T.
+template<typename T>
+struct termComponent {
+    using type = std::remove_const_t<T>;
+};
+
+template<typename T>
+struct termComponent<changed<T>> {
+    using type = T;
+};
+
+template<typename T>
+struct termComponent<added<T>> {
+    using type = T;
+};
+
+template<typename T>
+using termComponent_t = typename termComponent<T>::type;
+
+template<typename ...Lists>
+struct concatLists;
+
+template<>
+struct concatLists<> {
+    using type = typeList<>;
+};
+
+template<typename ...A>
+struct concatLists<typeList<A...>> {
+    using type = typeList<A...>;
+};
+
+template<typename ...A, typename ...B, typename ...Rest>
+struct concatLists<typeList<A...>, typeList<B...>, Rest...> {
+    using type = typename concatLists<typeList<A..., B...>, Rest...>::type;
+};
+
+// Terms handed to the callback, and the row filters.
+template<typename ...Terms>
+using queryComponents = typename concatLists<
+    std::conditional_t<isRowFilter<Terms>, typeList<>, typeList<Terms>>...>::type;
+
+template<typename ...Terms>
+using queryFilters = typename concatLists<
+    std::conditional_t<isRowFilter<Terms>, typeList<Terms>, typeList<>>...>::type;
+
+// Sort query terms into row terms (components and row filters), excluded
+// and optional components. with<> groups and nested queries are flattened.
+template<typename T>
+struct queryParts {
+    using rows = typeList<T>;
+    using excluded = typeList<>;
+    using optionals = typeList<>;
+};
+
+template<typename ...Ts>
+struct queryParts<with<Ts...>> : queryParts<query<Ts...>> {};
+
+template<typename ...Ts>
+struct queryParts<without<Ts...>> {
+    using rows = typeList<>;
+    using excluded = typeList<Ts...>;
+    using optionals = typeList<>;
+};
+
+template<typename ...Ts>
+struct queryParts<optional<Ts...>> {
+    using rows = typeList<>;
+    using excluded = typeList<>;
+    using optionals = typeList<Ts...>;
+};
+
+template<typename ...Terms>
+struct queryParts<query<Terms...>> {
+    using rows = typename concatLists<typename queryParts<Terms>::rows...>::type;
+    using excluded = typename concatLists<typename queryParts<Terms>::excluded...>::type;
+    using optionals = typename concatLists<typename queryParts<Terms>::optionals...>::type;
+};
+
+// Compile-time archetype match: has every row term, none of the excluded.
+template<typename Query, typename Archetype>
+constexpr bool queryMatches() {
+    using parts = queryParts<Query>;
+    return []<typename ...R, typename ...X>(typeList<R...>, typeList<X...>) {
+        return Archetype::template hasComponents<R...>() && !(Archetype::template hasComponent<X>() || ...);
+    }(typename parts::rows{}, typename parts::excluded{});
+}
+
+// Optional components the archetype actually holds.
+template<typename Archetype, typename ...Ts>
+using presentComponents = typename concatLists<
+    std::conditional_t<Archetype::template hasComponent<Ts>(), typeList<Ts>, typeList<>>...>::type;
+
+} // namespace gxe
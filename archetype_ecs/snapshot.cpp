@@ -0,0 +1,113 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GXE_HAS_MMAP 1
+#else
+#define GXE_HAS_MMAP 0
+#endif
+
+namespace gxe {
+
+snapshotWriter::snapshotWriter(std::ostream& out) : _out(&out) {
+    _buffer.reserve(BUFFER_BYTES);
+}
+
+void snapshotWriter::write(const void* data, std::size_t bytes) {
+    const std::byte* src = static_cast<const std::byte*>(data);
+    _offset += bytes;
+    if (_out && _buffer.size() + bytes > BUFFER_BYTES) {
+        finish();
+        if (bytes >= BUFFER_BYTES) {
+            _out->write(reinterpret_cast<const char*>(src), static_cast<std::streamsize>(bytes));
+            return;
+        }
+    }
+    _buffer.insert(_buffer.end(), src, src + bytes);
+}
+
+void snapshotWriter::align() {
+    static constexpr std::byte zeros[SNAPSHOT_ALIGNMENT] = {};
+    std::size_t pad = (SNAPSHOT_ALIGNMENT - _offset % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+    write(zeros, pad);
+}
+
+bool snapshotWriter::finish() {
+    if (!_out) {
+        return true;
+    }
+    _out->write(reinterpret_cast<const char*>(_buffer.data()), static_cast<std::streamsize>(_buffer.size()));
+    _buffer.clear();
+    return bool(*_out);
+}
+
+void snapshotReader::align() {
+    _offset = std::min(_data.size(), (_offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT);
+}
+
+const std::byte* snapshotReader::take(std::size_t bytes) {
+    if (!_ok || bytes > _data.size() - _offset) {
+        _ok = false;
+        return nullptr;
+    }
+    const std::byte* src = _data.data() + _offset;
+    _offset += bytes;
+    return src;
+}
+
+mappedFile::mappedFile(const std::string& path) {
+#if GXE_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            ::madvise(data, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+            _data = static_cast<const std::byte*>(data);
+            _size = static_cast<std::size_t>(info.st_size);
+            _mapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return;
+    }
+    _fallback.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    if (file.read(reinterpret_cast<char*>(_fallback.data()), static_cast<std::streamsize>(_fallback.size()))) {
+        _data = _fallback.data();
+        _size = _fallback.size();
+    }
+#endif
+}
+
+mappedFile::~mappedFile() {
+#if GXE_HAS_MMAP
+    if (_mapped) {
+        ::munmap(const_cast<std::byte*>(_data), _size);
+    }
+#endif
+}
+
+bool writeFile(const std::string& path, std::span<const std::byte> bytes) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return bool(file);
+}
+
+} // namespace gxe
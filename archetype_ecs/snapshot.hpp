@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gxe {
+
+// World snapshot file (see ecs::saveSnapshot / ecs::loadSnapshot):
+//   snapshotHeader
+//   idManager: record count, free list head/tail, live count, EntityRecord[]
+//   per archetype: row count, entityid[rows], then one T[rows] per component
+// Every array starts SNAPSHOT_ALIGNMENT aligned, so a mapped file can be read
+// in place. Components must be trivially copyable; soa<T> columns are stored
+// as T rows like any other column.
+constexpr inline std::size_t SNAPSHOT_ALIGNMENT = 64;
+constexpr inline uint32_t SNAPSHOT_VERSION = 2; // 2: 8-byte EntityRecord
+
+struct snapshotHeader {
+    char magic[8] = {'G', 'X', 'E', 'S', 'N', 'A', 'P', '\0'};
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t archetypes = 0;
+    uint64_t layout = 0; // layoutHash of the ecs type that wrote it
+};
+
+// FNV-1a, used to fingerprint the archetype/component layout.
+constexpr uint64_t hashBytes(std::string_view bytes, uint64_t hash = 14695981039346656037ull) {
+    for (char c : bytes) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+constexpr uint64_t hashValue(uint64_t value, uint64_t hash) {
+    for (int i = 0; i < 8; ++i) {
+        hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Appends snapshot data. Either streams to an ostream in bounded pieces
+// (large arrays bypass the buffer), or collects everything in memory.
+class snapshotWriter {
+public:
+    static constexpr std::size_t BUFFER_BYTES = 1 << 20;
+
+    snapshotWriter() = default;
+    explicit snapshotWriter(std::ostream& out);
+
+    snapshotWriter(const snapshotWriter&) = delete;
+    snapshotWriter& operator=(const snapshotWriter&) = delete;
+
+    void write(const void* data, std::size_t bytes);
+
+    template<typename T>
+    void value(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshot values must be trivially copyable");
+        write(&v, sizeof(T));
+    }
+
+    // Zero-pad to the next SNAPSHOT_ALIGNMENT boundary.
+    void align();
+
+    uint64_t offset() const { return _offset; }
+
+    // In-memory writers: preallocate for a snapshot of about `bytes`.
+    void reserve(std::size_t bytes) { _buffer.reserve(bytes); }
+
+    // Flush the buffer to the stream. False if the stream failed.
+    bool finish();
+
+    // In-memory writers: the collected bytes.
+    std::vector<std::byte> take() { return std::move(_buffer); }
+
+private:
+    std::ostream* _out = nullptr;
+    std::vector<std::byte> _buffer;
+    uint64_t _offset = 0;
+};
+
+// Reads snapshot data in place from a byte range (usually a mappedFile).
+// Every read is bounds checked; after the first failure ok() is false and
+// all further reads return empty results.
+class snapshotReader {
+public:
+    explicit snapshotReader(std::span<const std::byte> data) : _data(data) {}
+
+    bool ok() const { return _ok; }
+
+    template<typename T>
+    bool value(T& out) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshot values must be trivially copyable");
+        const std::byte* src = take(sizeof(T));
+        if (src) {
+            std::memcpy(static_cast<void*>(&out), src, sizeof(T));
+        }
+        return src != nullptr;
+    }
+
+    // Aligned array of count T, viewed in place.
+    template<typename T>
+    std::span<const T> array(std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshot arrays must be trivially copyable");
+        static_assert(alignof(T) <= SNAPSHOT_ALIGNMENT, "Over-aligned snapshot array");
+        align();
+        if (count > _data.size() / sizeof(T)) {
+            _ok = false;
+            return {};
+        }
+        const std::byte* src = take(count * sizeof(T));
+        return src ? std::span<const T>(reinterpret_cast<const T*>(src), count) : std::span<const T>();
+    }
+
+    void align();
+
+private:
+    const std::byte* take(std::size_t bytes);
+
+    std::span<const std::byte> _data;
+    std::size_t _offset = 0;
+    bool _ok = true;
+};
+
+// Read-only memory map of a whole file (falls back to reading it into memory
+// where mmap is unavailable). Empty on failure.
+class mappedFile {
+public:
+    explicit mappedFile(const std::string& path);
+    ~mappedFile();
+
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const { return {_data, _size}; }
+    bool isOpen() const { return _data != nullptr; }
+
+private:
+    const std::byte* _data = nullptr;
+    std::size_t _size = 0;
+    [[maybe_unused]] bool _mapped = false;
+    std::vector<std::byte> _fallback;
+};
+
+// Write bytes to path (used by ecs::saveSnapshotAsync on its own thread).
+bool writeFile(const std::string& path, std::span<const std::byte> bytes);
+
+} // namespace gxe
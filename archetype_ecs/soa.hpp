@@ -0,0 +1,253 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstddef>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace gxe {
+
+// Component stored behind an archetype column: soa<T> -> T.
+template<typename T>
+struct componentOf {
+    using type = T;
+};
+
+template<typename T>
+struct componentOf<soa<T>> {
+    using type = T;
+};
+
+template<typename T>
+using componentOf_t = typename componentOf<T>::type;
+
+template<typename T>
+constexpr bool isSoa = false;
+
+template<typename T>
+constexpr bool isSoa<soa<T>> = true;
+
+template<typename T>
+constexpr size_t soaFieldCount = std::tuple_size_v<std::remove_const_t<decltype(soaFields<T>::members)>>;
+
+template<typename T, size_t I>
+using soaFieldType = std::remove_cvref_t<decltype(std::declval<T&>().*std::get<I>(soaFields<T>::members))>;
+
+template<typename A, typename B>
+constexpr bool sameMember(A, B) {
+    return false;
+}
+
+template<typename A>
+constexpr bool sameMember(A a, A b) {
+    return a == b;
+}
+
+// Position of Member in soaFields<T>::members.
+template<typename T, auto Member, size_t I = 0>
+constexpr size_t soaFieldIndex() {
+    static_assert(I < soaFieldCount<T>, "Member not listed in soaFields");
+    if constexpr (sameMember(std::get<I>(soaFields<T>::members), Member)) {
+        return I;
+    } else {
+        return soaFieldIndex<T, Member, I + 1>();
+    }
+}
+
+// Per-field helpers for a SoA component.
+template<typename T, typename Seq = std::make_index_sequence<soaFieldCount<T>>>
+struct soaTraits;
+
+template<typename T, size_t... I>
+struct soaTraits<T, std::index_sequence<I...>> {
+    static_assert(std::is_default_constructible_v<T>, "SoA components must be default constructible");
+
+    using pointers = std::tuple<soaFieldType<T, I>*...>;
+
+    // One Container<Field> per field, e.g. a column vector each.
+    template<template<typename> class Container>
+    using containers = std::tuple<Container<soaFieldType<T, I>>...>;
+
+    static pointers addresses(T& value) {
+        return pointers{&(value.*std::get<I>(soaFields<T>::members))...};
+    }
+
+    static pointers offset(const pointers& fields, size_t n) {
+        return pointers{(std::get<I>(fields) + n)...};
+    }
+
+    // fields: a tuple of per-field pointers or containers
+    template<typename Fields>
+    static T load(const Fields& fields, size_t row) {
+        T value{};
+        ((value.*std::get<I>(soaFields<T>::members) = std::get<I>(fields)[row]), ...);
+        return value;
+    }
+
+    static void store(const pointers& fields, size_t row, const T& value) {
+        ((std::get<I>(fields)[row] = value.*std::get<I>(soaFields<T>::members)), ...);
+    }
+};
+
+// Proxy reference to one row of a SoA column. Reads gather the fields into a
+// T and writes scatter them back:
+//   Position p = ref;  ref = p;  ref.field<&Position::x>() += 1.0f;
+// A null soaRef (default constructed) tests false.
+template<typename T>
+class soaRef {
+public:
+    using pointers = typename soaTraits<T>::pointers;
+
+    soaRef() = default;
+    explicit soaRef(const pointers& fields) : _fields(fields) {}
+
+    // View a plain struct through the same interface.
+    soaRef(T& value) : _fields(soaTraits<T>::addresses(value)) {}
+
+    soaRef(const soaRef&) = default;
+
+    // Assignment writes through, like any reference.
+    soaRef& operator=(const soaRef& other) {
+        return *this = other.load();
+    }
+
+    soaRef& operator=(const T& value) {
+        soaTraits<T>::store(_fields, 0, value);
+        return *this;
+    }
+
+    T load() const {
+        return soaTraits<T>::load(_fields, 0);
+    }
+
+    operator T() const {
+        return load();
+    }
+
+    template<auto Member>
+    auto& field() const {
+        return *std::get<soaFieldIndex<T, Member>()>(_fields);
+    }
+
+    explicit operator bool() const {
+        return std::get<0>(_fields) != nullptr;
+    }
+
+private:
+    pointers _fields{};
+};
+
+// Pointer to a row of a SoA column: one pointer per field.
+template<typename T>
+class soaPtr {
+public:
+    using pointers = typename soaTraits<T>::pointers;
+
+    explicit soaPtr(const pointers& fields) : _fields(fields) {}
+
+    soaPtr operator+(size_t n) const {
+        return soaPtr(soaTraits<T>::offset(_fields, n));
+    }
+
+    soaRef<T> operator[](size_t row) const {
+        return soaRef<T>(soaTraits<T>::offset(_fields, row));
+    }
+
+    template<auto Member>
+    auto* field() const {
+        return std::get<soaFieldIndex<T, Member>()>(_fields);
+    }
+
+private:
+    pointers _fields;
+};
+
+// Block of a SoA column as handed out by forEachChunk: a span per field.
+//   soaSpan<Position> pos;  std::span<float> xs = pos.field<&Position::x>();
+template<typename T>
+class soaSpan {
+public:
+    soaSpan(soaPtr<T> data, size_t count) : _data(data), _count(count) {}
+
+    size_t size() const {
+        return _count;
+    }
+
+    soaRef<T> operator[](size_t row) const {
+        return _data[row];
+    }
+
+    template<auto Member>
+    auto field() const {
+        return std::span(_data.template field<Member>(), _count);
+    }
+
+private:
+    soaPtr<T> _data;
+    size_t _count;
+};
+
+template<typename T>
+std::span<T> columnSpan(T* data, size_t count) {
+    return std::span<T>(data, count);
+}
+
+template<typename T>
+soaSpan<T> columnSpan(soaPtr<T> data, size_t count) {
+    return soaSpan<T>(data, count);
+}
+
+// Argument for iteration lambdas taking T&. Plain column references pass
+// straight through; SoA rows are gathered into a local and stored back when
+// the call returns.
+template<typename Ref>
+class rowArg {
+public:
+    rowArg(Ref ref) : _ref(ref) {}
+
+    Ref get() {
+        return _ref;
+    }
+
+private:
+    Ref _ref;
+};
+
+template<typename T>
+class rowArg<soaRef<T>> {
+public:
+    rowArg(soaRef<T> ref) : _ref(ref), _value(ref.load()) {}
+
+    rowArg(const rowArg&) = delete;
+    rowArg& operator=(const rowArg&) = delete;
+
+    ~rowArg() {
+        _ref = _value;
+    }
+
+    T& get() {
+        return _value;
+    }
+
+private:
+    soaRef<T> _ref;
+    T _value;
+};
+
+// Call func(T&...) for one row given column references (T&) or SoA proxies.
+template<typename Func, typename ...Refs>
+void invokeRow(Func&& func, Refs&&... refs) {
+    if constexpr ((std::is_lvalue_reference_v<Refs> && ...)) {
+        func(refs...);
+    } else {
+        std::tuple<rowArg<Refs>...> args(refs...);
+        std::apply([&](auto&... arg) {
+            func(arg.get()...);
+        }, args);
+    }
+}
+
+} // namespace gxe
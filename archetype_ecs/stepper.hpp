@@ -0,0 +1,145 @@
+#pragma once
+
+#include "query.hpp"
+#include "threadPool.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace gxe {
+
+// Copy of the declared columns of every entity that has all of them, taken
+// right after a step. Row i of every column belongs to ids()[i].
+template<typename... Columns>
+class frameSnapshot {
+public:
+    uint64_t frame() const { return _frame; } // Steps run by the stepper when taken
+    size_t size() const { return _ids.size(); }
+    std::span<const entityid> ids() const { return _ids; }
+
+    template<typename T>
+    std::span<const T> column() const {
+        return std::get<std::vector<T>>(_columns);
+    }
+
+private:
+    template<typename ECS, typename... Cs>
+    friend class overlappedStepper;
+
+    uint64_t _frame = 0;
+    std::vector<entityid> _ids;
+    std::tuple<std::vector<Columns>...> _columns;
+};
+
+// Runs world steps on the thread pool while the calling thread renders the
+// previous one: frame time tends to max(simulation, render) instead of the sum.
+//   gxe::overlappedStepper<World, Position, EColor> stepper(world);
+//   while (running) {
+//       const auto& frame = stepper.sync(); // Step N done; the world is ours again
+//       spawnFromInput(world);
+//       stepper.launch(dt);                 // Step N + 1 starts on the pool
+//       draw(frame);                        // Step N's Position/EColor columns
+//   }
+//   stepper.sync();
+// Between launch() and sync() the world belongs to the step: the launching
+// thread must not touch it, only the frame returned by the last sync(), which
+// stays valid until the sync() after that. Only the declared columns are
+// copied (double buffered); with no columns the stepper just overlaps the
+// step. Needs a pool with workers; with one thread the step runs in sync().
+template<typename ECS, typename... Columns>
+class overlappedStepper {
+public:
+    using frame = frameSnapshot<Columns...>;
+
+    explicit overlappedStepper(ECS& world) : _world(world) {}
+    ~overlappedStepper() { sync(); }
+
+    overlappedStepper(const overlappedStepper&) = delete;
+    overlappedStepper& operator=(const overlappedStepper&) = delete;
+
+    // Sync point: wait for the step in flight (helping with its work) and
+    // publish its snapshot. Returns the newest frame.
+    const frame& sync() {
+        if (_inFlight) {
+            _world.pool().wait(_pending);
+            _inFlight = false;
+            _front ^= 1;
+        }
+        return _frames[_front];
+    }
+
+    // Start the next step on the pool. The snapshot it takes goes to the
+    // buffer not returned by the last sync().
+    void launch(float dt) {
+        assert(!_inFlight && "launch() without sync() since the last launch()");
+        _dt = dt;
+        _inFlight = true;
+        _pending.store(1, std::memory_order_relaxed);
+        task t{[](void* ctx, size_t, size_t) { static_cast<overlappedStepper*>(ctx)->simulate(); }, this, 0, 1, &_pending};
+        _world.pool().submit(std::span<const task>(&t, 1));
+    }
+
+    // sync() then launch(dt): the frame to draw while dt is simulated.
+    const frame& step(float dt) {
+        const frame& current = sync();
+        launch(dt);
+        return current;
+    }
+
+    bool inFlight() const { return _inFlight; }
+
+private:
+    void simulate() {
+        _world.step(_dt);
+        capture(_frames[_front ^ 1]);
+    }
+
+    void capture(frame& out) {
+        out._frame = ++_steps;
+        if constexpr (sizeof...(Columns) > 0) {
+            size_t n = _world.template queryCount<query<const Columns...>>();
+            out._ids.resize(n);
+            (std::get<std::vector<Columns>>(out._columns).resize(n), ...);
+
+            size_t offset = 0;
+            _world.template forEachChunk<const Columns...>([&](auto... spans) {
+                auto all = std::tuple(spans...);
+                std::span<const entityid> ids = std::get<sizeof...(Columns)>(all);
+                std::copy(ids.begin(), ids.end(), out._ids.begin() + offset);
+                [&]<size_t... I>(std::index_sequence<I...>) {
+                    (copyColumn(std::get<I>(all), std::get<I>(out._columns).data() + offset), ...);
+                }(std::index_sequence_for<Columns...>{});
+                offset += ids.size();
+            });
+        }
+    }
+
+    // Plain columns are one copy, SoA columns are gathered row by row.
+    template<typename Span, typename T>
+    static void copyColumn(const Span& column, T* out) {
+        if constexpr (requires { column.data(); }) {
+            std::copy(column.begin(), column.end(), out);
+        } else {
+            for (size_t i = 0; i < column.size(); ++i) {
+                out[i] = column[i];
+            }
+        }
+    }
+
+    ECS& _world;
+    frame _frames[2];
+    uint32_t _front = 0;  // Frame handed out by sync()
+    uint64_t _steps = 0;
+    float _dt = 0.0f;
+    bool _inFlight = false;
+    std::atomic<size_t> _pending{0};
+};
+
+} // namespace gxe
@@ -0,0 +1,508 @@
+#pragma once
+
+#include "soa.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gxe {
+
+// Storage option for archetype: archetype<chunked<>, Position, Velocity>.
+// Rows live in fixed-size chunks holding every column, so growth only appends
+// a chunk and component addresses stay valid until the row is removed.
+template<size_t ChunkBytes = DEFAULT_CHUNK_BYTES>
+struct chunked {};
+
+// Allocator aligning every column to COLUMN_ALIGNMENT, so blocks handed out
+// by forEachBlock start on a cache line. Memory comes from the world's
+// memory resource (see memory.hpp); the allocator follows its contents on
+// assignment and swap.
+template<typename T>
+struct alignedAllocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    alignedAllocator() = default;
+
+    alignedAllocator(std::pmr::memory_resource* resource) : _resource(resource) {}
+
+    template<typename U>
+    alignedAllocator(const alignedAllocator<U>& other) : _resource(other.resource()) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(_resource->allocate(n * sizeof(T), COLUMN_ALIGNMENT));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        _resource->deallocate(ptr, n * sizeof(T), COLUMN_ALIGNMENT);
+    }
+
+    std::pmr::memory_resource* resource() const {
+        return _resource;
+    }
+
+    template<typename U>
+    bool operator==(const alignedAllocator<U>& other) const {
+        return *_resource == *other.resource();
+    }
+
+private:
+    std::pmr::memory_resource* _resource = std::pmr::get_default_resource();
+};
+
+template<typename T>
+using columnVector = std::vector<T, alignedAllocator<T>>;
+
+// Column of a soa<T> component: one aligned vector per field of T.
+// Rows are read and written through soaRef proxies.
+template<typename T>
+class soaColumn {
+    using traits = soaTraits<T>;
+
+public:
+    explicit soaColumn(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        std::apply([resource](auto&... vecs) {
+            ((vecs = std::remove_reference_t<decltype(vecs)>(resource)), ...);
+        }, _fields);
+    }
+
+    size_t size() const {
+        return std::get<0>(_fields).size();
+    }
+
+    void reserve(size_t rows) {
+        std::apply([rows](auto&... vecs) {
+            (vecs.reserve(rows), ...);
+        }, _fields);
+    }
+
+    template<typename ...Args>
+    void emplace_back(Args&&... args) {
+        size_t row = size();
+        resize(row + 1);
+        traits::store(pointers(), row, T(std::forward<Args>(args)...));
+    }
+
+    void append(std::span<const T> values) {
+        size_t first = size();
+        resize(first + values.size());
+        typename traits::pointers fields = pointers();
+        for (size_t i = 0; i < values.size(); ++i) {
+            traits::store(fields, first + i, values[i]);
+        }
+    }
+
+    void resize(size_t rows) {
+        std::apply([rows](auto&... vecs) {
+            (vecs.resize(rows), ...);
+        }, _fields);
+    }
+
+    soaPtr<T> data() {
+        return soaPtr<T>(pointers());
+    }
+
+    soaRef<T> operator[](size_t row) {
+        return data()[row];
+    }
+
+    T operator[](size_t row) const {
+        return traits::load(_fields, row);
+    }
+
+private:
+    typename traits::pointers pointers() {
+        return std::apply([](auto&... vecs) {
+            return typename traits::pointers{vecs.data()...};
+        }, _fields);
+    }
+
+    typename traits::template containers<columnVector> _fields;
+};
+
+// Column pointer as seen by a request for T or const T.
+template<typename Requested, typename T>
+Requested* requestedColumn(T* column) {
+    return column;
+}
+
+template<typename Requested, typename T>
+soaPtr<T> requestedColumn(soaPtr<T> column) {
+    return column;
+}
+
+template<typename C>
+struct columnFor {
+    using type = columnVector<C>;
+};
+
+template<typename T>
+struct columnFor<soa<T>> {
+    using type = soaColumn<T>;
+};
+
+// Storages expose the same interface to archetype:
+//   size, reserve, push, append, appendDefault, entityAt, get<T>, moveRow, truncate and
+//   forEachBlock<T...>(begin, end, f) which calls
+//   f(const entityid* ids, size_t count, T*... columns) once per contiguous block.
+// T may be const-qualified for read-only access.
+// Blocks starting at row 0 or at a ROWS_PER_BLOCK boundary are COLUMN_ALIGNMENT aligned.
+
+// One vector per column. The whole archetype is a single block.
+// soa<T> columns keep one vector per field of T; get<T> and forEachBlock then
+// hand out soaRef<T> / soaPtr<T> instead of T& / T*.
+template<typename ...Components>
+class vectorStorage {
+    template<typename C>
+    using column_t = typename columnFor<C>::type;
+
+public:
+    static constexpr size_t ROWS_PER_BLOCK = std::numeric_limits<size_t>::max();
+
+    vectorStorage(size_t reserveSize, std::pmr::memory_resource* resource)
+        : _entityIds(resource)
+        , _components(column_t<Components>(resource)...) {
+        reserve(reserveSize);
+    }
+
+    size_t size() const {
+        return _entityIds.size();
+    }
+
+    void reserve(size_t rows) {
+        _entityIds.reserve(rows);
+        std::apply([rows](auto&... vecs) {
+            (vecs.reserve(rows), ...);
+        }, _components);
+    }
+
+    template<typename ...Args>
+    archetypeid push(entityid id, Args&&... components) {
+        archetypeid row = static_cast<archetypeid>(_entityIds.size());
+        _entityIds.push_back(id);
+        (std::get<column_t<Components>>(_components).emplace_back(std::forward<Args>(components)), ...);
+        return row;
+    }
+
+    // Bulk append: one insert per column (memmove for trivially copyable types).
+    archetypeid append(std::span<const entityid> ids, std::span<const componentOf_t<Components>>... columns) {
+        archetypeid first = static_cast<archetypeid>(_entityIds.size());
+        _entityIds.insert(_entityIds.end(), ids.begin(), ids.end());
+        (appendColumn(std::get<column_t<Components>>(_components), columns), ...);
+        return first;
+    }
+
+    // Bulk append of value-initialized rows, to be filled in place.
+    archetypeid appendDefault(std::span<const entityid> ids) {
+        archetypeid first = static_cast<archetypeid>(_entityIds.size());
+        _entityIds.insert(_entityIds.end(), ids.begin(), ids.end());
+        std::apply([n = _entityIds.size()](auto&... vecs) {
+            (vecs.resize(n), ...);
+        }, _components);
+        return first;
+    }
+
+    entityid& entityAt(size_t row) {
+        return _entityIds[row];
+    }
+
+    entityid entityAt(size_t row) const {
+        return _entityIds[row];
+    }
+
+    // T& (or soaRef<T> for soa<T> columns)
+    template<typename T>
+    decltype(auto) get(size_t row) {
+        if constexpr (std::is_const_v<T>) {
+            return std::as_const(*this).template get<std::remove_const_t<T>>(row);
+        } else {
+            return column<T>()[row];
+        }
+    }
+
+    template<typename T>
+    decltype(auto) get(size_t row) const {
+        return std::get<columnIndex<T>()>(_components)[row];
+    }
+
+    void moveRow(size_t dst, size_t src) {
+        _entityIds[dst] = _entityIds[src];
+        std::apply([dst, src](auto&... vecs) {
+            ((vecs[dst] = std::move(vecs[src])), ...);
+        }, _components);
+    }
+
+    void truncate(size_t rows) {
+        _entityIds.erase(_entityIds.begin() + rows, _entityIds.end());
+        std::apply([rows](auto&... vecs) {
+            (truncateColumn(vecs, rows), ...);
+        }, _components);
+    }
+
+    template<typename ...Requested, typename Func>
+    void forEachBlock(size_t begin, size_t end, Func&& func) {
+        if (begin < end) {
+            func(_entityIds.data() + begin, end - begin,
+                 requestedColumn<Requested>(column<std::remove_const_t<Requested>>().data() + begin)...);
+        }
+    }
+
+private:
+    template<typename T>
+    static constexpr size_t columnIndex() {
+        return typeIndex<std::remove_const_t<T>, componentOf_t<Components>...>();
+    }
+
+    template<typename T>
+    auto& column() {
+        return std::get<columnIndex<T>()>(_components);
+    }
+
+    template<typename T>
+    static void appendColumn(columnVector<T>& column, std::span<const T> values) {
+        column.insert(column.end(), values.begin(), values.end());
+    }
+
+    template<typename T>
+    static void appendColumn(soaColumn<T>& column, std::span<const T> values) {
+        column.append(values);
+    }
+
+    template<typename T>
+    static void truncateColumn(columnVector<T>& column, size_t rows) {
+        column.erase(column.begin() + rows, column.end());
+    }
+
+    template<typename T>
+    static void truncateColumn(soaColumn<T>& column, size_t rows) {
+        column.resize(rows);
+    }
+
+    columnVector<entityid> _entityIds; // archetypeID -> global entityID mapping for reverse lookup.
+    std::tuple<column_t<Components>...> _components; // Component storage
+};
+
+// Fixed-size chunks, each holding ROWS_PER_CHUNK rows of every column:
+//   [entity ids][column 0][column 1]...  (each column COLUMN_ALIGNMENT aligned)
+// Row r lives in chunk r / ROWS_PER_CHUNK at slot r % ROWS_PER_CHUNK.
+template<size_t ChunkBytes, typename ...Components>
+class chunkStorage {
+    static constexpr size_t N_COLUMNS = sizeof...(Components) + 1; // + entity ids
+
+    static constexpr size_t alignUp(size_t value) {
+        return (value + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+    }
+
+    // Byte offset of every column in a chunk holding `rows` rows, plus the total size.
+    static constexpr std::array<size_t, N_COLUMNS + 1> layout(size_t rows) {
+        constexpr std::array<size_t, N_COLUMNS> sizes{sizeof(entityid), sizeof(Components)...};
+        std::array<size_t, N_COLUMNS + 1> offsets{};
+        size_t offset = 0;
+        for (size_t i = 0; i < N_COLUMNS; ++i) {
+            offset = alignUp(offset);
+            offsets[i] = offset;
+            offset += sizes[i] * rows;
+        }
+        offsets[N_COLUMNS] = offset;
+        return offsets;
+    }
+
+    static constexpr size_t rowsPerChunk() {
+        size_t rowBytes = (sizeof(entityid) + ... + sizeof(Components));
+        size_t rows = ChunkBytes / rowBytes;
+        while (rows > 0 && layout(rows)[N_COLUMNS] > ChunkBytes) {
+            --rows;
+        }
+        return rows;
+    }
+
+public:
+    static constexpr size_t ROWS_PER_CHUNK = rowsPerChunk();
+    static constexpr size_t ROWS_PER_BLOCK = ROWS_PER_CHUNK;
+    static_assert(ROWS_PER_CHUNK > 0, "Chunk too small for a single row");
+    static_assert(((alignof(Components) <= COLUMN_ALIGNMENT) && ...), "Over-aligned component");
+    static_assert((!isSoa<Components> && ...), "soa<> columns require vector storage");
+
+    chunkStorage(size_t reserveSize, std::pmr::memory_resource* resource)
+        : _resource(resource)
+        , _chunks(resource) {
+        reserve(reserveSize);
+    }
+
+    chunkStorage(chunkStorage&& other) noexcept
+        : _resource(other._resource)
+        , _chunks(std::move(other._chunks))
+        , _size(std::exchange(other._size, 0)) {}
+
+    chunkStorage& operator=(chunkStorage&& other) noexcept {
+        if (this != &other) {
+            truncate(0);
+            _resource = other._resource;
+            _chunks = std::move(other._chunks);
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+
+    ~chunkStorage() {
+        truncate(0);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // Allocates chunks up front; never moves existing rows.
+    void reserve(size_t rows) {
+        while (_chunks.size() * ROWS_PER_CHUNK < rows) {
+            _chunks.emplace_back(static_cast<std::byte*>(_resource->allocate(ChunkBytes, COLUMN_ALIGNMENT)),
+                                 chunkDeleter{_resource});
+        }
+    }
+
+    template<typename ...Args>
+    archetypeid push(entityid id, Args&&... components) {
+        reserve(_size + 1);
+        archetypeid row = static_cast<archetypeid>(_size);
+        std::byte* chunk = chunkOf(row);
+        size_t slot = slotOf(row);
+
+        std::construct_at(ids(chunk) + slot, id);
+        (std::construct_at(column<Components>(chunk) + slot, std::forward<Args>(components)), ...);
+        ++_size;
+        return row;
+    }
+
+    // Bulk append, filling each chunk's columns with one copy per column.
+    archetypeid append(std::span<const entityid> newIds, std::span<const Components>... columns) {
+        return appendBlocks(newIds.size(), [&](std::byte* chunk, size_t slot, size_t offset, size_t count) {
+            copyConstruct(ids(chunk) + slot, newIds.data() + offset, count);
+            (copyConstruct(column<Components>(chunk) + slot, columns.data() + offset, count), ...);
+        });
+    }
+
+    // Bulk append of value-initialized rows, to be filled in place.
+    archetypeid appendDefault(std::span<const entityid> newIds) {
+        return appendBlocks(newIds.size(), [&](std::byte* chunk, size_t slot, size_t offset, size_t count) {
+            copyConstruct(ids(chunk) + slot, newIds.data() + offset, count);
+            (std::uninitialized_value_construct_n(column<Components>(chunk) + slot, count), ...);
+        });
+    }
+
+    entityid& entityAt(size_t row) {
+        return ids(chunkOf(row))[slotOf(row)];
+    }
+
+    entityid entityAt(size_t row) const {
+        return ids(chunkOf(row))[slotOf(row)];
+    }
+
+    template<typename T>
+    T& get(size_t row) {
+        return column<std::remove_const_t<T>>(chunkOf(row))[slotOf(row)];
+    }
+
+    template<typename T>
+    const T& get(size_t row) const {
+        return column<std::remove_const_t<T>>(chunkOf(row))[slotOf(row)];
+    }
+
+    void moveRow(size_t dst, size_t src) {
+        entityAt(dst) = entityAt(src);
+        ((get<Components>(dst) = std::move(get<Components>(src))), ...);
+    }
+
+    // Destroys rows >= rows. Chunks stay allocated for reuse.
+    void truncate(size_t rows) {
+        if constexpr (!(std::is_trivially_destructible_v<Components> && ...)) {
+            for (size_t row = rows; row < _size; ++row) {
+                (std::destroy_at(&get<Components>(row)), ...);
+            }
+        }
+        _size = std::min(_size, rows);
+    }
+
+    template<typename ...Requested, typename Func>
+    void forEachBlock(size_t begin, size_t end, Func&& func) {
+        size_t row = begin;
+        while (row < end) {
+            std::byte* chunk = chunkOf(row);
+            size_t slot = slotOf(row);
+            size_t count = std::min(ROWS_PER_CHUNK - slot, end - row);
+            func(ids(chunk) + slot, count, static_cast<Requested*>(column<std::remove_const_t<Requested>>(chunk) + slot)...);
+            row += count;
+        }
+    }
+
+private:
+    struct chunkDeleter {
+        std::pmr::memory_resource* resource;
+
+        void operator()(std::byte* chunk) const {
+            resource->deallocate(chunk, ChunkBytes, COLUMN_ALIGNMENT);
+        }
+    };
+
+    static constexpr std::array<size_t, N_COLUMNS + 1> OFFSETS = layout(ROWS_PER_CHUNK);
+
+    // Reserve count rows and call fill(chunk, slot, offset, count) per chunk-sized piece.
+    template<typename Fill>
+    archetypeid appendBlocks(size_t count, Fill&& fill) {
+        archetypeid first = static_cast<archetypeid>(_size);
+        reserve(_size + count);
+        for (size_t offset = 0; offset < count;) {
+            size_t row = _size + offset;
+            size_t n = std::min(ROWS_PER_CHUNK - slotOf(row), count - offset);
+            fill(chunkOf(row), slotOf(row), offset, n);
+            offset += n;
+        }
+        _size += count;
+        return first;
+    }
+
+    template<typename T>
+    static void copyConstruct(T* dst, const T* src, size_t count) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            std::memcpy(static_cast<void*>(dst), src, count * sizeof(T));
+        } else {
+            std::uninitialized_copy_n(src, count, dst);
+        }
+    }
+
+    std::byte* chunkOf(size_t row) const {
+        return _chunks[row / ROWS_PER_CHUNK].get();
+    }
+
+    static size_t slotOf(size_t row) {
+        return row % ROWS_PER_CHUNK;
+    }
+
+    static entityid* ids(std::byte* chunk) {
+        return std::launder(reinterpret_cast<entityid*>(chunk + OFFSETS[0]));
+    }
+
+    template<typename T>
+    static T* column(std::byte* chunk) {
+        return std::launder(reinterpret_cast<T*>(chunk + OFFSETS[typeIndex<T, Components...>() + 1]));
+    }
+
+    std::pmr::memory_resource* _resource;
+    std::pmr::vector<std::unique_ptr<std::byte, chunkDeleter>> _chunks; // Stable, only ever appended
+    size_t _size = 0;
+};
+
+} // namespace gxe
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "types.hpp"
+
+#include <algorithm>
 #include <functional>
-#include <optional>
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
 // Systems can be created to update at some frequency T,
 // or triggered manually.
@@ -11,6 +15,23 @@
 // a pointer to the ECS.
 
 // Systems should be archetype agnostic, instead utilizing components.
+
+// Component access declarations for systems, see SystemCRTP.
+template<typename... Components>
+struct reads {};
+
+template<typename... Components>
+struct writes {};
+
+// How a fixed-rate system catches up after a long frame. At most maxSubsteps
+// ticks run per update (0 = no limit); afterwards any accumulated time beyond
+// maxCarryTicks ticks is dropped, so a slow frame cannot snowball into a
+// slower one.
+struct substepPolicy {
+    uint32_t maxSubsteps = 8;
+    float maxCarryTicks = 1.0f;
+};
+
 // Base class handling tick rate and time accumulation
 
 class SystemBase {
@@ -22,29 +43,135 @@ public:
 
     virtual ~SystemBase() = default;
 
-    // Virtual update for polymorphic calls through base pointer
-    void update(float dt) {
+    // Virtual update for polymorphic calls through base pointer.
+    // Returns the number of ticks run (fixed-rate systems may run several or none).
+    uint32_t update(float dt) {
         if (_tickrate == 0) {
             tick(dt);
-            return;
+            return 1;
         }
 
-        _accumulatedTime += dt;
+        uint32_t substeps = consumeSubsteps(dt);
+        if (substeps > 0) {
+            tickBatch(_secsPerTick, substeps);
+        }
+        return substeps;
+    }
 
-        while (_accumulatedTime >= _secsPerTick) {
-            tick(_secsPerTick);
-            _accumulatedTime -= _secsPerTick;
+    // update() with tick/tickBatch called on the concrete type instead of
+    // through the vtable, so the compiler can inline them (ecs::pipeline).
+    // Derived's tick must be public.
+    template<typename Derived>
+    uint32_t updateDirect(float dt) {
+        Derived& self = static_cast<Derived&>(*this);
+        if (_tickrate == 0) {
+            self.Derived::tick(dt);
+            return 1;
         }
+
+        uint32_t substeps = consumeSubsteps(dt);
+        if constexpr (std::is_same_v<decltype(&Derived::tickBatch), void (SystemBase::*)(float, uint32_t)>) {
+            for (uint32_t i = 0; i < substeps; ++i) {
+                self.Derived::tick(_secsPerTick);
+            }
+        } else if (substeps > 0) {
+            self.Derived::tickBatch(_secsPerTick, substeps);
+        }
+        return substeps;
     }
 
     uint32_t tickrate() const { return _tickrate; }
 
+    void setSubstepPolicy(const substepPolicy& policy) { _policy = policy; }
+    const substepPolicy& getSubstepPolicy() const { return _policy; }
+
+    // Fraction of a tick accumulated but not yet simulated, in [0, 1]. Render
+    // state at lerp(previous, current, alpha()) to hide the fixed rate.
+    float alpha() const {
+        return _tickrate > 0 ? std::min(_accumulatedTime / _secsPerTick, 1.0f) : 1.0f;
+    }
+
+    // Systems that never declared their component access are exclusive:
+    // the scheduler never runs them alongside any other system.
+    bool exclusive() const { return _exclusive; }
+
+    // Change tick of the system's previous run; changed<T>/added<T> filters
+    // inside tick() only match rows written after it. Maintained by the ecs.
+    uint32_t lastRunTick() const { return _lastRunTick; }
+    void setLastRunTick(uint32_t tick) { _lastRunTick = tick; }
+
+    const std::vector<gxe::componentid>& readSet() const { return _reads; }
+    const std::vector<gxe::componentid>& writeSet() const { return _writes; }
+
+    // Two systems conflict when either writes a component the other touches.
+    bool conflictsWith(const SystemBase& other) const {
+        if (_exclusive || other._exclusive) {
+            return true;
+        }
+
+        auto contains = [](const std::vector<gxe::componentid>& set, gxe::componentid id) {
+            return std::find(set.begin(), set.end(), id) != set.end();
+        };
+        for (gxe::componentid id : _writes) {
+            if (contains(other._writes, id) || contains(other._reads, id)) {
+                return true;
+            }
+        }
+        for (gxe::componentid id : other._writes) {
+            if (contains(_reads, id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
 protected:
     virtual void tick(float dt) = 0;
 
+    // Run `substeps` ticks of dt back to back. Override to fuse them, e.g.
+    // integrate every substep per entity in a single pass over memory.
+    virtual void tickBatch(float dt, uint32_t substeps) {
+        for (uint32_t i = 0; i < substeps; ++i) {
+            tick(dt);
+        }
+    }
+
+    // Add dt and take out the ticks due under the substep policy.
+    uint32_t consumeSubsteps(float dt) {
+        _accumulatedTime += dt;
+
+        uint32_t substeps = 0;
+        while (_accumulatedTime >= _secsPerTick &&
+               (_policy.maxSubsteps == 0 || substeps < _policy.maxSubsteps)) {
+            _accumulatedTime -= _secsPerTick;
+            ++substeps;
+        }
+        _accumulatedTime = std::min(_accumulatedTime, _policy.maxCarryTicks * _secsPerTick);
+        return substeps;
+    }
+
+    template<typename... Components>
+    void declareAccess(reads<Components...>) {
+        _exclusive = false;
+        (_reads.push_back(gxe::componentId<Components>()), ...);
+    }
+
+    template<typename... Components>
+    void declareAccess(writes<Components...>) {
+        _exclusive = false;
+        (_writes.push_back(gxe::componentId<Components>()), ...);
+    }
+
     const uint32_t _tickrate;
     float _accumulatedTime;
     float _secsPerTick;
+    substepPolicy _policy;
+
+    uint32_t _lastRunTick = 0;
+
+    bool _exclusive = true;
+    std::vector<gxe::componentid> _reads;
+    std::vector<gxe::componentid> _writes;
 };
 
 // CRTP base for custom systems - derive from this to create your own system types
@@ -54,11 +181,18 @@ protected:
 //       MyPhysicsSystem(ECSType& ecs) : SystemCRTP(60, ecs) {}
 //       void tick(float dt) { /* custom logic using _ecs */ }
 //   };
-template <typename Derived, typename ECS>
+//
+// Access lists the components the system touches, which lets ecs::step run
+// non-conflicting systems concurrently:
+//   class Mover : public SystemCRTP<Mover, ECSType, reads<Velocity>, writes<Position>>
+// Without an access list the system is exclusive and runs on its own.
+template <typename Derived, typename ECS, typename... Access>
 class SystemCRTP : public SystemBase {
 public:
     SystemCRTP(ECS& world, uint32_t tickrate = 0) // Default of update as frequently as possible
-        : SystemBase(tickrate), _world(world) {}
+        : SystemBase(tickrate), _world(world) {
+        (declareAccess(Access{}), ...);
+    }
 
 protected:
     ECS& _world; // Reference to the world with which this system operates in
@@ -85,10 +219,10 @@ public:
 protected:
     void tick(float sysDelta) override {
         if(_tickImpl){
-            (*_tickImpl)(sysDelta);
+            _tickImpl(sysDelta);
         }
     }
 
 private:
-    std::optional<std::function<void(float)>> _tickImpl;
+    std::function<void(float)> _tickImpl; // Empty until tickDef
 };
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "../query.hpp"
+#include "../system.hpp"
+#include "../types.hpp"
+
+namespace gxe {
+
+// Destroys entities when their Lifetime runs out, without touching the ones
+// that don't. Each Lifetime is given an absolute expiry tick the first time
+// the system sees it (ttl seconds from then, at the system's tickrate) and is
+// filed in a hierarchical timing wheel; a tick only visits the bucket that is
+// due, so the cost follows the number of expiries rather than the population.
+// Expired entities are destroyed through the command buffer at the end of the
+// step. Assigning a fresh Lifetime{ttl} reschedules the entity.
+template <typename ECS>
+class LifetimeSystem : public SystemCRTP<LifetimeSystem<ECS>, ECS, writes<Lifetime>> {
+    using lifetimes = query<Lifetime, changed<Lifetime>>;
+    using arrivals = query<const Lifetime, added<Lifetime>>;
+
+public:
+    static constexpr uint32_t SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t LEVELS = 4; // 4 x 8 bits: the whole 32-bit tick range
+
+    // Lifetimes are counted in ticks, so the system needs a fixed rate:
+    // throws std::invalid_argument for tickrate 0.
+    LifetimeSystem(ECS& ecs, uint32_t tickrate = 60)
+        : SystemCRTP<LifetimeSystem<ECS>, ECS, writes<Lifetime>>(ecs, tickrate) {
+        if (tickrate == 0) {
+            throw std::invalid_argument("gxe::LifetimeSystem: tickrate must be greater than 0");
+        }
+    }
+
+    void tick(float) {
+        tickBatch(0.0f, 1);
+    }
+
+    // Schedule new lifetimes once, then advance the wheel tick by tick.
+    void tickBatch(float, uint32_t substeps) {
+        schedule();
+        for (uint32_t i = 0; i < substeps; ++i) {
+            advance();
+        }
+    }
+
+    uint32_t now() const { return _now; }
+    size_t pending() const { return _pending; } // Wheel entries, including stale ones
+
+private:
+    struct entry {
+        entityid id;
+        uint32_t expiresAt;
+    };
+
+    // Give unscheduled lifetimes an expiry tick and file every lifetime whose
+    // entity (re)appeared, e.g. by a snapshot load or a checkpoint restore.
+    void schedule() {
+        this->_world.template forEachQuery<arrivals>([this](entityid id, const Lifetime& lt) {
+            if (lt.expiresAt != 0) {
+                insert(entry{id, lt.expiresAt});
+            }
+        });
+
+        this->_world.template forEachQuery<lifetimes>([this](entityid id, Lifetime& lt) {
+            if (lt.expiresAt == 0) {
+                lt.expiresAt = expiryOf(lt.ttl);
+                insert(entry{id, lt.expiresAt});
+            }
+        });
+    }
+
+    uint32_t expiryOf(float ttl) const {
+        double ticks = std::ceil(double(ttl) * this->tickrate());
+        ticks = std::clamp(ticks, 1.0, double(UINT32_MAX - _now));
+        return _now + static_cast<uint32_t>(ticks);
+    }
+
+    // Entries already past due (restored from an earlier tick) expire next
+    // tick. They keep their own expiresAt, which advance() compares with the
+    // Lifetime's to tell them from rescheduled ones.
+    void insert(const entry& e) {
+        if (e.expiresAt <= _now) {
+            _overdue.push_back(e);
+            ++_pending;
+        } else {
+            place(e);
+        }
+    }
+
+    // An entry sits on the lowest level whose slot range still contains both
+    // now and its expiry, so it moves down a level each time its range comes up.
+    void place(const entry& e) {
+        uint32_t level = 0;
+        while (level + 1 < LEVELS && (e.expiresAt >> (SLOT_BITS * (level + 1))) != (_now >> (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        _wheel[level][(e.expiresAt >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(e);
+        ++_pending;
+    }
+
+    void advance() {
+        ++_now;
+
+        // Entering a new range of a level: spread its bucket over the levels below.
+        for (uint32_t level = LEVELS - 1; level > 0; --level) {
+            if ((_now & ((1u << (SLOT_BITS * level)) - 1)) == 0) {
+                cascade(_wheel[level][(_now >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+            }
+        }
+
+        std::vector<entry>& due = _wheel[0][_now & (SLOTS - 1)];
+        if (due.empty() && _overdue.empty()) {
+            return;
+        }
+        _expired.clear();
+        expire(due);
+        expire(_overdue);
+        this->_world.commands().destroy(std::span<const entityid>(_expired));
+    }
+
+    // Collect the entities of bucket into _expired and empty it.
+    void expire(std::vector<entry>& bucket) {
+        for (const entry& e : bucket) {
+            // Skip entities destroyed meanwhile, or rescheduled to a later tick.
+            const Lifetime* lt = this->_world.template tryGetComponent<const Lifetime>(e.id);
+            if (lt && lt->expiresAt == e.expiresAt) {
+                _expired.push_back(e.id);
+            }
+        }
+        _pending -= bucket.size();
+        bucket.clear();
+    }
+
+    void cascade(std::vector<entry>& bucket) {
+        _pending -= bucket.size();
+        _moving.swap(bucket);
+        for (const entry& e : _moving) {
+            place(e); // Due now lands in the level 0 bucket about to fire
+        }
+        _moving.clear();
+    }
+
+    uint32_t _now = 1; // 0 marks an unscheduled Lifetime
+    size_t _pending = 0;
+    std::array<std::array<std::vector<entry>, SLOTS>, LEVELS> _wheel;
+    std::vector<entry> _overdue; // Filed already past due, expire next tick
+
+    // Reused between ticks.
+    std::vector<entityid> _expired;
+    std::vector<entry> _moving;
+};
+
+} // namespace gxe
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "../query.hpp"
+#include "../system.hpp"
+#include "../types.hpp"
+
+namespace gxe {
+
+// One drawable as seen by the renderer: where, which batch, and who.
+struct renderInstance {
+    float x, y;
+    uint32_t key; // Sort key: the EColor index
+    entityid id;
+};
+
+// Render extraction: packs every entity with Position and EColor into one
+// contiguous instance array, sorted by key, so a renderer can walk it (or
+// hand each key's run to an instanced draw) without touching the world:
+//   auto& extract = world.registerSystem<RenderExtractSystem>();
+//   world.step(dt);
+//   for (const renderInstance& inst : extract.instances()) { ... }
+// The array is double buffered: a run fills the back buffer and swaps it in,
+// so instances() stays valid while the next run extracts. Runs where only
+// Position changed copy the previous array and patch the moved rows instead
+// of sorting again; runs where nothing changed keep the current array.
+template <typename ECS>
+class RenderExtractSystem : public SystemCRTP<RenderExtractSystem<ECS>, ECS, reads<Position, EColor>> {
+    using drawables = query<const Position, const EColor>;
+
+public:
+    RenderExtractSystem(ECS& ecs, uint32_t tickrate = 0)
+        : SystemCRTP<RenderExtractSystem<ECS>, ECS, reads<Position, EColor>>(ecs, tickrate) {}
+
+    void tick(float) {
+        extract();
+    }
+
+    // Rebuild, patch or keep the instance array, whichever the changes
+    // since the last run call for.
+    void extract() {
+        if (structureChanged()) {
+            rebuild();
+        } else if (positionsChanged()) {
+            patch();
+        }
+    }
+
+    // Gather and sort every drawable unconditionally.
+    void rebuild() {
+        gather();
+        sortByKey();
+        swap();
+        ++_rebuilds;
+    }
+
+    // Current array, ordered by key (stable: world order within a key).
+    std::span<const renderInstance> instances() const {
+        return front();
+    }
+
+    // The run of instances with the given key, e.g. for one instanced draw.
+    std::span<const renderInstance> batch(uint32_t key) const {
+        std::span<const renderInstance> all = front();
+        auto [first, last] = std::equal_range(all.begin(), all.end(), renderInstance{0.0f, 0.0f, key, 0}, byKey);
+        return all.subspan(size_t(first - all.begin()), size_t(last - first));
+    }
+
+    // Bumped every time a new array is swapped in.
+    uint64_t version() const { return _version; }
+    uint64_t rebuilds() const { return _rebuilds; }
+
+private:
+    static constexpr size_t SORT_GRAIN = 16 * 1024;
+    static constexpr size_t PATCH_GRAIN = 64 * 1024;
+    static constexpr uint32_t MAX_DENSE_KEYS = 4096; // Larger keys fall back to a comparison sort
+
+    static bool byKey(const renderInstance& a, const renderInstance& b) {
+        return a.key < b.key;
+    }
+
+    // Rows [begin, begin + count) of one chunk; they go to _staging from offset on.
+    struct segment {
+        const entityid* begin;
+        size_t count;
+        size_t offset;
+    };
+
+    std::span<const renderInstance> front() const {
+        return std::span<const renderInstance>(_buffers[_front]);
+    }
+
+    std::vector<renderInstance>& back() {
+        return _buffers[_front ^ 1];
+    }
+
+    void swap() {
+        _front ^= 1;
+        ++_version;
+    }
+
+    // Drawables entered or left, or one changed key, since the last run.
+    bool structureChanged() {
+        auto& world = this->_world;
+        bool dirty = world.template queryCount<drawables>() != front().size() || _version == 0;
+        auto mark = [&dirty](const auto&...) { dirty = true; };
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const EColor, changed<EColor>>(mark);
+        }
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const EColor, added<Position>>(mark);
+        }
+        return dirty;
+    }
+
+    bool positionsChanged() {
+        bool dirty = false;
+        this->_world.template forEachWithComponents<const Position, const EColor, changed<Position>>(
+            [&dirty](const auto&...) { dirty = true; });
+        return dirty;
+    }
+
+    // Lay the chunks out back to back (cheap, one entry per chunk), then copy
+    // the rows into _staging on the pool.
+    void gather() {
+        auto& world = this->_world;
+        _segments.clear();
+        size_t total = 0;
+        world.template forEachChunk<const Position, const EColor>([&](auto, auto, std::span<const entityid> ids) {
+            _segments.push_back(segment{ids.data(), ids.size(), total});
+            total += ids.size();
+        });
+        std::sort(_segments.begin(), _segments.end(), [](const segment& a, const segment& b) {
+            return std::less<const entityid*>()(a.begin, b.begin);
+        });
+        _staging.resize(total);
+
+        world.template forEachChunkParallel<const Position, const EColor>([this](auto pos, auto color, std::span<const entityid> ids) {
+            renderInstance* out = _staging.data() + offsetOf(ids.data());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                Position p = pos[i];
+                out[i] = renderInstance{p.x, p.y, static_cast<uint32_t>(color[i].col), ids[i]};
+            }
+        });
+    }
+
+    // Position in _staging of the row whose id is at ids.
+    size_t offsetOf(const entityid* ids) const {
+        auto it = std::upper_bound(_segments.begin(), _segments.end(), ids, [](const entityid* p, const segment& s) {
+            return std::less<const entityid*>()(p, s.begin);
+        });
+        const segment& s = *(it - 1);
+        return s.offset + size_t(ids - s.begin);
+    }
+
+    // Stable counting sort of _staging into the back buffer (per-range key
+    // counts, one prefix sum, per-range scatter), recording each entity's slot.
+    void sortByKey() {
+        threadPool& pool = this->_world.pool();
+        size_t n = _staging.size();
+        size_t ranges = (n + SORT_GRAIN - 1) / SORT_GRAIN;
+        std::vector<renderInstance>& out = back();
+        out.resize(n);
+
+        uint32_t maxKey = 0;
+        size_t slots = 0;
+        for (const renderInstance& inst : _staging) {
+            maxKey = std::max(maxKey, inst.key);
+            slots = std::max(slots, size_t(entityIndex(inst.id)) + 1);
+        }
+        uint32_t keys = n > 0 ? maxKey + 1 : 0;
+        _slotOf.resize(slots);
+
+        if (keys > MAX_DENSE_KEYS) {
+            std::copy(_staging.begin(), _staging.end(), out.begin());
+            std::stable_sort(out.begin(), out.end(), byKey);
+            for (size_t i = 0; i < n; ++i) {
+                _slotOf[entityIndex(out[i].id)] = static_cast<uint32_t>(i);
+            }
+            return;
+        }
+
+        // _counts[r * keys + k]: rows of key k in range r, then where they go.
+        _counts.assign(ranges * keys, 0);
+        pool.parallelFor(n, SORT_GRAIN, [this, keys](size_t begin, size_t end) {
+            size_t* counts = _counts.data() + begin / SORT_GRAIN * keys;
+            for (size_t i = begin; i < end; ++i) {
+                counts[_staging[i].key]++;
+            }
+        });
+
+        size_t next = 0;
+        for (uint32_t key = 0; key < keys; ++key) {
+            for (size_t r = 0; r < ranges; ++r) {
+                size_t count = _counts[r * keys + key];
+                _counts[r * keys + key] = next;
+                next += count;
+            }
+        }
+
+        // Staging is in world order, so the slot map is written front to back.
+        pool.parallelFor(n, SORT_GRAIN, [this, keys, &out](size_t begin, size_t end) {
+            size_t* fill = _counts.data() + begin / SORT_GRAIN * keys;
+            for (size_t i = begin; i < end; ++i) {
+                size_t slot = fill[_staging[i].key]++;
+                out[slot] = _staging[i];
+                _slotOf[entityIndex(_staging[i].id)] = static_cast<uint32_t>(slot);
+            }
+        });
+    }
+
+    // Same drawables and keys: start from the current array and rewrite the
+    // positions of rows in changed blocks.
+    void patch() {
+        std::span<const renderInstance> current = front();
+        std::vector<renderInstance>& out = back();
+        out.resize(current.size());
+        this->_world.pool().parallelFor(current.size(), PATCH_GRAIN, [&](size_t begin, size_t end) {
+            std::memcpy(static_cast<void*>(out.data() + begin), current.data() + begin, (end - begin) * sizeof(renderInstance));
+        });
+
+        this->_world.template forEachWithComponentsParallel<const Position, const EColor, changed<Position>>(
+            [this, &out](entityid id, const Position& pos, const EColor&) {
+                renderInstance& inst = out[_slotOf[entityIndex(id)]];
+                inst.x = pos.x;
+                inst.y = pos.y;
+            });
+        swap();
+    }
+
+    std::vector<renderInstance> _buffers[2];
+    uint32_t _front = 0;
+    uint64_t _version = 0;
+    uint64_t _rebuilds = 0;
+
+    // Reused between runs.
+    std::vector<segment> _segments;
+    std::vector<renderInstance> _staging; // Gathered in world order
+    std::vector<size_t> _counts;          // Per sort range and key
+    std::vector<uint32_t> _slotOf;        // Entity index -> slot in the newest array
+};
+
+} // namespace gxe
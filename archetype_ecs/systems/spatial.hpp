@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../query.hpp"
+#include "../system.hpp"
+#include "../types.hpp"
+
+namespace gxe {
+
+// Colliders are entities with Position plus an AABB or a Circle, both relative
+// to Position: the box spans [x + xmin, x + xmax] x [y + ymin, y + ymax], the
+// circle is centred on (x + xpos, y + ypos). An entity with both uses its AABB.
+
+inline AABB worldBounds(const Position& pos, const AABB& box) {
+    return AABB{pos.x + box.xmin, pos.x + box.xmax, pos.y + box.ymin, pos.y + box.ymax};
+}
+
+inline AABB worldBounds(const Position& pos, const Circle& circle) {
+    float cx = pos.x + circle.xpos;
+    float cy = pos.y + circle.ypos;
+    return AABB{cx - circle.radius, cx + circle.radius, cy - circle.radius, cy + circle.radius};
+}
+
+inline bool overlaps(const AABB& a, const AABB& b) {
+    return a.xmin <= b.xmax && b.xmin <= a.xmax && a.ymin <= b.ymax && b.ymin <= a.ymax;
+}
+
+// Squared distance from a point to a box (0 inside).
+inline float distanceSq(const AABB& box, float x, float y) {
+    float dx = std::max({box.xmin - x, 0.0f, x - box.xmax});
+    float dy = std::max({box.ymin - y, 0.0f, y - box.ymax});
+    return dx * dx + dy * dy;
+}
+
+struct spatialPair {
+    entityid a;
+    entityid b;
+};
+
+// Broadphase over every collider: a loose, hashed uniform grid. Each collider
+// lives in the one cell holding its centre, and queries widen their search by
+// half the largest collider extent, so colliders never straddle cells and the
+// grid needs no world bounds. Cells hash into a power-of-two bucket table,
+// stored as one array ordered by bucket (bounds and ids side by side), where
+// each bucket keeps some free slots after its colliders.
+//
+// tick() keeps the grid in step with the world. Colliders that moved or were
+// resized (rows in changed<> blocks) are updated in place, or moved to the
+// free slots of their new cell's bucket (shifting its neighbours over by a
+// slot when it has none); the grid is only rebuilt from scratch when
+// colliders are added or removed, no free slot is near, or a collider
+// outgrows the cells. Queries see the world as of the
+// last run and are safe to call concurrently with each other.
+template <typename ECS>
+class SpatialSystem : public SystemCRTP<SpatialSystem<ECS>, ECS, reads<Position, AABB, Circle>> {
+    using boxColliders = query<const Position, const AABB>;
+    using circleColliders = query<const Position, const Circle, without<AABB>>;
+
+public:
+    // cellSize 0 sizes cells to the largest collider; a smaller value is
+    // raised to it, so overlaps are always found within neighbouring cells.
+    SpatialSystem(ECS& ecs, float cellSize = 0.0f, uint32_t tickrate = 0)
+        : SystemCRTP<SpatialSystem<ECS>, ECS, reads<Position, AABB, Circle>>(ecs, tickrate)
+        , _requestedCellSize(cellSize) {}
+
+    void tick(float) {
+        if (collidersChanged() || !update()) {
+            rebuild();
+        }
+    }
+
+    // Gather every collider and rebuild the grid unconditionally.
+    void rebuild() {
+        _items.clear();
+        _slots = 0;
+        this->_world.template forEachQuery<boxColliders>([this](entityid id, const Position& pos, const AABB& box) {
+            addItem(id, worldBounds(pos, box));
+        });
+        this->_world.template forEachQuery<circleColliders>([this](entityid id, const Position& pos, const Circle& circle) {
+            addItem(id, worldBounds(pos, circle));
+        });
+        buildGrid();
+    }
+
+    size_t size() const { return _size; }
+    uint64_t rebuilds() const { return _rebuilds; }
+    float cellSize() const { return _cellSize; }
+
+    // Colliders whose bounds overlap box; ids are appended to out.
+    void queryBox(const AABB& box, std::vector<entityid>& out) const {
+        forEachCandidate(box, [&](const item& it) {
+            if (overlaps(it.bounds, box)) {
+                out.push_back(it.id);
+            }
+        });
+    }
+
+    // Colliders whose bounds come within radius of (x, y).
+    void queryRadius(float x, float y, float radius, std::vector<entityid>& out) const {
+        float radiusSq = radius * radius;
+        forEachCandidate(AABB{x - radius, x + radius, y - radius, y + radius}, [&](const item& it) {
+            if (distanceSq(it.bounds, x, y) <= radiusSq) {
+                out.push_back(it.id);
+            }
+        });
+    }
+
+    // Up to k colliders closest to (x, y) by distance to their bounds, nearest
+    // first, appended to out. Searches rings of cells outwards, starting at
+    // the first ring that reaches the occupied cells and skipping cells outside
+    // them; once the rings have probed more cells than there are colliders it
+    // scans the colliders instead, so far away points cost one linear pass.
+    void nearest(float x, float y, size_t k, std::vector<entityid>& out) const {
+        if (k == 0 || _size == 0) {
+            return;
+        }
+        std::vector<std::pair<float, entityid>> best; // Sorted, at most k
+        best.reserve(k + 1);
+        auto consider = [&](const item& it) {
+            float d = distanceSq(it.bounds, x, y);
+            if (best.size() < k || d < best.back().first) {
+                auto at = std::upper_bound(best.begin(), best.end(), d,
+                    [](float v, const std::pair<float, entityid>& e) { return v < e.first; });
+                best.insert(at, {d, it.id});
+                if (best.size() > k) {
+                    best.pop_back();
+                }
+            }
+        };
+
+        int64_t cx = cellCoord(x);
+        int64_t cy = cellCoord(y);
+        int64_t x0 = _minCell[0], x1 = _maxCell[0], y0 = _minCell[1], y1 = _maxCell[1];
+        int64_t firstRing = std::max({x0 - cx, cx - x1, y0 - cy, cy - y1, int64_t(0)});
+        int64_t lastRing = std::max({cx - x0, x1 - cx, cy - y0, y1 - cy});
+        size_t probed = 0;
+        for (int64_t ring = firstRing; ring <= lastRing; ++ring) {
+            // The ring's cells inside the occupied range: whole top and bottom
+            // rows, the left and right columns in between.
+            int64_t gx0 = std::max(cx - ring, x0), gx1 = std::min(cx + ring, x1);
+            int64_t gy0 = std::max(cy - ring, y0), gy1 = std::min(cy + ring, y1);
+            size_t cells = 0;
+            for (int64_t gy = gy0; gy <= gy1; ++gy) {
+                if (gy == cy - ring || gy == cy + ring) {
+                    cells += size_t(gx1 - gx0 + 1);
+                } else {
+                    cells += size_t(cx - ring >= x0) + size_t(ring > 0 && cx + ring <= x1);
+                }
+            }
+            probed += cells;
+            if (probed > _size) {
+                best.clear();
+                forEachItem(consider);
+                break;
+            }
+
+            for (int64_t gy = gy0; gy <= gy1; ++gy) {
+                if (gy == cy - ring || gy == cy + ring) {
+                    for (int64_t gx = gx0; gx <= gx1; ++gx) {
+                        forEachInCell(int32_t(gx), int32_t(gy), consider);
+                    }
+                } else {
+                    if (cx - ring >= x0) {
+                        forEachInCell(int32_t(cx - ring), int32_t(gy), consider);
+                    }
+                    if (ring > 0 && cx + ring <= x1) {
+                        forEachInCell(int32_t(cx + ring), int32_t(gy), consider);
+                    }
+                }
+            }
+            // Cells beyond this ring hold centres at least ring * cellSize away.
+            float reach = float(ring) * _cellSize - _maxHalfExtent;
+            if (best.size() == k && reach > 0.0f && best.back().first <= reach * reach) {
+                break;
+            }
+        }
+        for (const auto& entry : best) {
+            out.push_back(entry.second);
+        }
+    }
+
+    // Every pair of colliders with overlapping bounds, each reported once,
+    // appended to out. Runs on the world's thread pool in ranges of `grain`
+    // colliders (0 = automatic).
+    void overlappingPairs(std::vector<spatialPair>& out, size_t grain = 0) {
+        size_t n = _sorted.size();
+        if (_size == 0) {
+            return;
+        }
+        threadPool& pool = this->_world.pool();
+        if (grain == 0) {
+            grain = std::max<size_t>(PAIR_GRAIN, n / (pool.threadCount() * 4) + 1);
+        }
+        size_t ranges = (n + grain - 1) / grain;
+        if (_rangePairs.size() < ranges) {
+            _rangePairs.resize(ranges);
+        }
+
+        pool.parallelFor(n, grain, [this, grain](size_t begin, size_t end) {
+            std::vector<spatialPair>& pairs = _rangePairs[begin / grain];
+            pairs.clear();
+            for (size_t i = begin; i < end; ++i) {
+                const item& a = _sorted[i];
+                if (a.id == NULL_ID) {
+                    continue; // Free slot
+                }
+                // Own cell (later items only), then the four forward
+                // neighbours; the other four see a from their side.
+                forEachInCell(a.cell[0], a.cell[1], [&](const item& b) {
+                    if (&b > &a && overlaps(a.bounds, b.bounds)) {
+                        pairs.push_back(spatialPair{a.id, b.id});
+                    }
+                });
+                for (const auto& offset : FORWARD_CELLS) {
+                    forEachInCell(a.cell[0] + offset[0], a.cell[1] + offset[1], [&](const item& b) {
+                        if (overlaps(a.bounds, b.bounds)) {
+                            pairs.push_back(spatialPair{a.id, b.id});
+                        }
+                    });
+                }
+            }
+        });
+
+        for (size_t r = 0; r < ranges; ++r) {
+            out.insert(out.end(), _rangePairs[r].begin(), _rangePairs[r].end());
+        }
+    }
+
+private:
+    static constexpr size_t PAIR_GRAIN = 1024;
+    static constexpr size_t MIN_BUCKETS = 64;
+    static constexpr size_t MIN_BUCKET_SLACK = 1; // Free slots per bucket, plus a quarter of its colliders
+    static constexpr size_t MAX_BORROW_DISTANCE = 64; // Buckets a full one may shift to find a free slot
+    static constexpr int32_t FORWARD_CELLS[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+    struct item {
+        AABB bounds;
+        entityid id; // NULL_ID in a bucket's free slots
+        int32_t cell[2];
+    };
+
+    // A collider entered or left since the last run.
+    bool collidersChanged() {
+        auto& world = this->_world;
+        bool dirty = world.template queryCount<boxColliders>() + world.template queryCount<circleColliders>() != _size;
+        auto mark = [&dirty](const auto&...) { dirty = true; };
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const AABB, added<Position>>(mark);
+        }
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const AABB, added<AABB>>(mark);
+        }
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const Circle, added<Position>>(mark);
+        }
+        if (!dirty) {
+            world.template forEachWithComponents<const Position, const Circle, added<Circle>>(mark);
+        }
+        return dirty;
+    }
+
+    // Same colliders as the grid: move the ones that moved or were resized
+    // since the last run. False if the grid must be rebuilt instead.
+    bool update() {
+        auto& world = this->_world;
+        bool ok = true;
+        auto box = [this, &ok](entityid id, const Position& pos, const AABB& shape) {
+            ok = ok && moveItem(id, worldBounds(pos, shape));
+        };
+        auto circle = [this, &ok](entityid id, const Position& pos, const Circle& shape) {
+            ok = ok && moveItem(id, worldBounds(pos, shape));
+        };
+        world.template forEachWithComponents<const Position, const AABB, changed<Position>>(box);
+        world.template forEachWithComponents<const Position, const AABB, changed<AABB>>(box);
+        world.template forEachQuery<query<const Position, const Circle, without<AABB>, changed<Position>>>(circle);
+        world.template forEachQuery<query<const Position, const Circle, without<AABB>, changed<Circle>>>(circle);
+        return ok;
+    }
+
+    // Give a collider new bounds, moving it to its new cell's bucket. False
+    // if it is not in the grid, outgrew the cells or no free slot was found
+    // near its new bucket.
+    bool moveItem(entityid id, const AABB& bounds) {
+        size_t index = entityIndex(id);
+        if (index >= _slotOf.size() || _slotOf[index] >= _sorted.size() || _sorted[_slotOf[index]].id != id) {
+            return false;
+        }
+        float extent = std::max(bounds.xmax - bounds.xmin, bounds.ymax - bounds.ymin);
+        if (extent > _cellSize) {
+            return false;
+        }
+        _maxHalfExtent = std::max(_maxHalfExtent, extent * 0.5f);
+
+        int32_t cx = cellCoord((bounds.xmin + bounds.xmax) * 0.5f);
+        int32_t cy = cellCoord((bounds.ymin + bounds.ymax) * 0.5f);
+        const item& current = _sorted[_slotOf[index]];
+        size_t from = bucketOf(current.cell[0], current.cell[1]);
+        size_t to = bucketOf(cx, cy);
+        if (from != to && isFull(to) && !borrowSlot(to)) {
+            return false;
+        }
+        size_t slot = _slotOf[index];
+        if (from != to) {
+            // Fill the hole with the bucket's last collider, append to the new bucket.
+            size_t last = _bucketStart[from] + --_bucketCount[from];
+            _sorted[slot] = _sorted[last];
+            _slotOf[entityIndex(_sorted[slot].id)] = static_cast<uint32_t>(slot);
+            _sorted[last].id = NULL_ID;
+            slot = _bucketStart[to] + _bucketCount[to]++;
+            _slotOf[index] = static_cast<uint32_t>(slot);
+        }
+        _sorted[slot] = item{bounds, id, {cx, cy}};
+        _minCell[0] = std::min(_minCell[0], cx);
+        _maxCell[0] = std::max(_maxCell[0], cx);
+        _minCell[1] = std::min(_minCell[1], cy);
+        _maxCell[1] = std::max(_maxCell[1], cy);
+        return true;
+    }
+
+    void addItem(entityid id, const AABB& bounds) {
+        _items.push_back(item{bounds, id, {0, 0}});
+        _slots = std::max(_slots, size_t(entityIndex(id)) + 1);
+    }
+
+    int32_t cellCoord(float v) const {
+        float cell = std::floor(v / _cellSize);
+        return static_cast<int32_t>(std::clamp(cell, float(INT32_MIN / 2), float(INT32_MAX / 2)));
+    }
+
+    size_t bucketOf(int32_t cx, int32_t cy) const {
+        // Cells along x land in consecutive buckets, so a row of neighbours
+        // is one contiguous run of _sorted.
+        uint32_t h = uint32_t(cx) + uint32_t(cy) * 2654435761u;
+        return h & (_bucketStart.size() - 2);
+    }
+
+    bool isFull(size_t bucket) const {
+        return _bucketCount[bucket] == _bucketStart[bucket + 1] - _bucketStart[bucket];
+    }
+
+    // Give a full bucket one more slot, taken from the nearest following
+    // bucket with a free one (or the end of the array): every bucket in
+    // between moves its first collider to its end and starts one slot later.
+    bool borrowSlot(size_t bucket) {
+        size_t buckets = _bucketCount.size();
+        size_t donor = bucket + 1;
+        while (donor < buckets && isFull(donor)) {
+            if (donor - bucket >= MAX_BORROW_DISTANCE) {
+                return false;
+            }
+            ++donor;
+        }
+        if (donor == buckets) {
+            _sorted.push_back(item{AABB{}, NULL_ID, {0, 0}});
+            _bucketStart[buckets]++;
+        }
+        for (size_t b = donor; b > bucket; --b) {
+            if (b == buckets) {
+                continue;
+            }
+            size_t first = _bucketStart[b];
+            if (_bucketCount[b] > 0) {
+                size_t end = first + _bucketCount[b];
+                _sorted[end] = _sorted[first];
+                _slotOf[entityIndex(_sorted[end].id)] = static_cast<uint32_t>(end);
+                _sorted[first].id = NULL_ID;
+            }
+            _bucketStart[b]++;
+        }
+        return true;
+    }
+
+    // Bucket the items by centre cell (counting sort into _sorted), leaving
+    // free slots after each bucket's items.
+    void buildGrid() {
+        float maxExtent = 0.0f;
+        for (const item& it : _items) {
+            maxExtent = std::max({maxExtent, it.bounds.xmax - it.bounds.xmin, it.bounds.ymax - it.bounds.ymin});
+        }
+        _maxHalfExtent = maxExtent * 0.5f;
+        _cellSize = std::max(_requestedCellSize, maxExtent);
+        if (_cellSize <= 0.0f) {
+            _cellSize = 1.0f;
+        }
+
+        size_t buckets = std::bit_ceil(std::max(MIN_BUCKETS, _items.size()));
+        _bucketStart.assign(buckets + 1, 0);
+        _bucketCount.assign(buckets, 0);
+        _minCell[0] = _minCell[1] = INT32_MAX;
+        _maxCell[0] = _maxCell[1] = INT32_MIN;
+        for (item& it : _items) {
+            it.cell[0] = cellCoord((it.bounds.xmin + it.bounds.xmax) * 0.5f);
+            it.cell[1] = cellCoord((it.bounds.ymin + it.bounds.ymax) * 0.5f);
+            for (int axis = 0; axis < 2; ++axis) {
+                _minCell[axis] = std::min(_minCell[axis], it.cell[axis]);
+                _maxCell[axis] = std::max(_maxCell[axis], it.cell[axis]);
+            }
+            _bucketCount[bucketOf(it.cell[0], it.cell[1])]++;
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            _bucketStart[b + 1] = _bucketStart[b] + _bucketCount[b] + _bucketCount[b] / 4 + MIN_BUCKET_SLACK;
+            _bucketCount[b] = 0;
+        }
+
+        _sorted.assign(_bucketStart[buckets], item{AABB{}, NULL_ID, {0, 0}});
+        _slotOf.resize(_slots);
+        for (const item& it : _items) {
+            size_t b = bucketOf(it.cell[0], it.cell[1]);
+            size_t slot = _bucketStart[b] + _bucketCount[b]++;
+            _sorted[slot] = it;
+            _slotOf[entityIndex(it.id)] = static_cast<uint32_t>(slot);
+        }
+        _size = _items.size();
+        ++_rebuilds;
+    }
+
+    // visit(item) for every item whose centre lies in cell (gx, gy).
+    template<typename Visit>
+    void forEachInCell(int32_t gx, int32_t gy, Visit&& visit) const {
+        size_t bucket = bucketOf(gx, gy);
+        for (size_t i = _bucketStart[bucket]; i < _bucketStart[bucket] + _bucketCount[bucket]; ++i) {
+            const item& it = _sorted[i];
+            if (it.cell[0] == gx && it.cell[1] == gy) {
+                visit(it);
+            }
+        }
+    }
+
+    // visit(item) for every item, skipping free slots.
+    template<typename Visit>
+    void forEachItem(Visit&& visit) const {
+        for (const item& it : _sorted) {
+            if (it.id != NULL_ID) {
+                visit(it);
+            }
+        }
+    }
+
+    // visit(item) for every item that may overlap box.
+    template<typename Visit>
+    void forEachCandidate(const AABB& box, Visit&& visit) const {
+        if (_size == 0) {
+            return;
+        }
+        int32_t x0 = std::max(cellCoord(box.xmin - _maxHalfExtent), _minCell[0]);
+        int32_t x1 = std::min(cellCoord(box.xmax + _maxHalfExtent), _maxCell[0]);
+        int32_t y0 = std::max(cellCoord(box.ymin - _maxHalfExtent), _minCell[1]);
+        int32_t y1 = std::min(cellCoord(box.ymax + _maxHalfExtent), _maxCell[1]);
+        if (x0 > x1 || y0 > y1) {
+            return;
+        }
+
+        // Large boxes: one linear pass beats probing every cell.
+        if (uint64_t(x1 - x0 + 1) * uint64_t(y1 - y0 + 1) >= _size) {
+            forEachItem(visit);
+            return;
+        }
+        for (int32_t gy = y0; gy <= y1; ++gy) {
+            for (int32_t gx = x0; gx <= x1; ++gx) {
+                forEachInCell(gx, gy, visit);
+            }
+        }
+    }
+
+    float _requestedCellSize;
+    float _cellSize = 1.0f;
+    float _maxHalfExtent = 0.0f;
+    int32_t _minCell[2] = {0, 0};
+    int32_t _maxCell[2] = {0, 0};
+
+    std::vector<item> _items;           // Gathered colliders, build scratch
+    size_t _slots = 0;                  // Largest gathered entity index + 1
+    std::vector<item> _sorted;          // Colliders ordered by bucket, with free slots
+    size_t _size = 0;                   // Colliders in _sorted
+    std::vector<size_t> _bucketStart;   // Bucket b owns _sorted[_bucketStart[b], _bucketStart[b + 1])
+    std::vector<size_t> _bucketCount;   // Colliders at the front of each bucket's range
+    std::vector<uint32_t> _slotOf;      // Entity index -> slot in _sorted
+    uint64_t _rebuilds = 0;
+    std::vector<std::vector<spatialPair>> _rangePairs; // Per-range pair output, reused
+};
+
+} // namespace gxe
@@ -0,0 +1,142 @@
+#include "threadPool.hpp"
+
+namespace gxe {
+
+namespace {
+thread_local const threadPool* t_pool = nullptr;
+thread_local size_t t_workerIndex = 0;
+}
+
+threadPool::threadPool(size_t threadCount, std::pmr::memory_resource* upstream) : _scratch(upstream) {
+    size_t nWorkers = threadCount > 1 ? threadCount - 1 : 0;
+
+    _queues.reserve(nWorkers + 1);
+    for (size_t i = 0; i <= nWorkers; ++i) {
+        _queues.push_back(std::make_unique<workQueue>(&_scratch));
+    }
+
+    _workers.reserve(nWorkers);
+    for (size_t i = 1; i <= nWorkers; ++i) {
+        _workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+threadPool::~threadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop.store(true);
+    }
+    _wake.notify_all();
+
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+size_t threadPool::workerIndex() const {
+    return t_pool == this ? t_workerIndex : 0;
+}
+
+void threadPool::submit(std::span<const task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    size_t nQueues = _queues.size();
+    size_t self = workerIndex();
+
+    if (self != 0 || nQueues == 1) {
+        // Workers keep their own work local, idle threads steal it.
+        workQueue& queue = *_queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.insert(queue.tasks.end(), tasks.begin(), tasks.end());
+    } else {
+        // External submitters deal the batch out so every worker starts
+        // with local work instead of contending on a single queue.
+        size_t first = _nextQueue.fetch_add(1, std::memory_order_relaxed);
+        size_t perQueue = (tasks.size() + nQueues - 1) / nQueues;
+        for (size_t q = 0, offset = 0; q < nQueues && offset < tasks.size(); ++q, offset += perQueue) {
+            size_t end = offset + perQueue < tasks.size() ? offset + perQueue : tasks.size();
+            workQueue& queue = *_queues[(first + q) % nQueues];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.insert(queue.tasks.end(), tasks.begin() + offset, tasks.begin() + end);
+        }
+    }
+
+    _queued.fetch_add(tasks.size(), std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    if (tasks.size() == 1) {
+        _wake.notify_one();
+    } else {
+        _wake.notify_all();
+    }
+}
+
+void threadPool::wait(const std::atomic<size_t>& pending) {
+    size_t self = workerIndex();
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (!tryRunOne(self)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void threadPool::workerLoop(size_t index) {
+    t_pool = this;
+    t_workerIndex = index;
+
+    while (true) {
+        if (tryRunOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this] {
+            return _stop.load() || _queued.load(std::memory_order_acquire) > 0;
+        });
+        if (_stop.load() && _queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool threadPool::tryRunOne(size_t self) {
+    task work;
+    if (!popLocal(self, work) && !steal(self, work)) {
+        return false;
+    }
+
+    _queued.fetch_sub(1, std::memory_order_relaxed);
+    work.fn(work.ctx, work.begin, work.end);
+    work.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool threadPool::popLocal(size_t self, task& out) {
+    workQueue& queue = *_queues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    out = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool threadPool::steal(size_t self, task& out) {
+    size_t nQueues = _queues.size();
+    for (size_t i = 1; i < nQueues; ++i) {
+        workQueue& queue = *_queues[(self + i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            out = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace gxe
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "memory.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace gxe {
+
+// A unit of work: run fn(ctx, begin, end), then decrement *pending.
+// Plain function pointer + context so submitting a range never allocates.
+struct task {
+    void (*fn)(void* ctx, size_t begin, size_t end) = nullptr;
+    void* ctx = nullptr;
+    size_t begin = 0;
+    size_t end = 0;
+    std::atomic<size_t>* pending = nullptr;
+};
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own work from the back and steals
+// from the front of the others. Threads outside the pool share queue 0, and
+// any thread waiting on a batch helps execute queued work instead of blocking.
+class threadPool {
+public:
+    // threadCount includes the calling thread, so 1 means "run inline".
+    // Task lists and queue nodes are recycled through a pool over upstream.
+    explicit threadPool(size_t threadCount = std::thread::hardware_concurrency(),
+                        std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~threadPool();
+
+    threadPool(const threadPool&) = delete;
+    threadPool& operator=(const threadPool&) = delete;
+
+    // Number of threads that can execute work, including the caller.
+    size_t threadCount() const { return _workers.size() + 1; }
+
+    // 0 for threads outside this pool, 1..N for pool workers.
+    size_t workerIndex() const;
+
+    // Thread-safe pool for short-lived buffers, such as task lists built each step.
+    std::pmr::memory_resource* scratch() { return &_scratch; }
+
+    // Queue tasks. Each task must point at a pending counter that already
+    // accounts for it.
+    void submit(std::span<const task> tasks);
+
+    // Execute queued work until pending reaches zero.
+    void wait(const std::atomic<size_t>& pending);
+
+    // Split [0, count) into grain-sized ranges, run func(begin, end) on all
+    // threads and block until every range has finished.
+    template<typename Func>
+    void parallelFor(size_t count, size_t grain, Func&& func) {
+        if (count == 0) {
+            return;
+        }
+        grain = grain > 0 ? grain : 1;
+        size_t nRanges = (count + grain - 1) / grain;
+        if (_workers.empty() || nRanges == 1) {
+            func(size_t(0), count);
+            return;
+        }
+
+        using FuncType = std::remove_reference_t<Func>;
+        std::atomic<size_t> pending(nRanges);
+        std::pmr::vector<task> tasks(&_scratch);
+        tasks.reserve(nRanges);
+        for (size_t begin = 0; begin < count; begin += grain) {
+            tasks.push_back(task{
+                [](void* ctx, size_t b, size_t e) { (*static_cast<FuncType*>(ctx))(b, e); },
+                const_cast<void*>(static_cast<const void*>(&func)),
+                begin,
+                begin + grain < count ? begin + grain : count,
+                &pending
+            });
+        }
+        submit(tasks);
+        wait(pending);
+    }
+
+private:
+    struct workQueue {
+        explicit workQueue(std::pmr::memory_resource* resource) : tasks(resource) {}
+
+        std::mutex mutex;
+        std::pmr::deque<task> tasks;
+    };
+
+    void workerLoop(size_t index);
+    bool tryRunOne(size_t self);
+    bool popLocal(size_t self, task& out);
+    bool steal(size_t self, task& out);
+
+    poolResource _scratch; // Declared first: queues allocate from it
+    std::vector<std::thread> _workers;
+    std::vector<std::unique_ptr<workQueue>> _queues; // [0] external threads, [1..N] workers
+
+    std::atomic<size_t> _queued{0};
+    std::atomic<bool> _stop{false};
+    std::atomic<size_t> _nextQueue{0};
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+};
+
+} // namespace gxe
@@ -1,30 +1,115 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 #include <limits>
+#include <tuple>
+#include <type_traits>
 
 namespace gxe {
 
+// Entity handles pack a slot index (low bits) and a generation (high bits).
+// The generation is bumped whenever a slot is freed, so a stale handle to a
+// reused slot is detected with a single compare.
+// The generation is ENTITY_GENERATIONS wide and wraps: a handle kept across
+// that many reuses of its slot validates again, against whichever entity then
+// owns the slot. The FIFO free list (see idManager) spreads reuse over every
+// free slot, so this takes ENTITY_GENERATIONS times the free list's length in
+// destroys, but under heavy churn with a short free list it comes quickly.
+// Do not hold handles to short-lived entities (e.g. particles) indefinitely.
 using entityid = uint32_t;
 using archetypeid = entityid;
 
 constexpr inline entityid NULL_ID = std::numeric_limits<entityid>::max();
 constexpr inline archetypeid NULL_ARCHETYPE_ID = std::numeric_limits<archetypeid>::max();
 
-constexpr inline std::size_t INITIAL_SPARSE_SET_CAPACITY = 1024;
+constexpr inline uint32_t ENTITY_INDEX_BITS = 24;
+constexpr inline entityid ENTITY_INDEX_MASK = (entityid(1) << ENTITY_INDEX_BITS) - 1;
+constexpr inline entityid MAX_ENTITY_INDEX = ENTITY_INDEX_MASK - 1; // ENTITY_INDEX_MASK is reserved for NULL_ID
+constexpr inline uint32_t ENTITY_GENERATIONS = 1u << (32 - ENTITY_INDEX_BITS); // Reuses of a slot before handles repeat
 
-// Type-erased base class for ECS to allow archetype -> ecs lookups
-class ecs_base {
-public:
-    virtual ~ecs_base() = default;
-    
-    // Get the archetype-local index for an entity
-    virtual archetypeid getArchetypeLocalId(entityid id) const = 0;
-    
-    // Update the archetype-local index for an entity (called during swap-and-pop)
-    virtual void setArchetypeLocalId(entityid id, archetypeid localId) = 0;
-};
+constexpr entityid entityIndex(entityid id) {
+    return id & ENTITY_INDEX_MASK;
+}
+
+constexpr uint8_t entityGeneration(entityid id) {
+    return static_cast<uint8_t>(id >> ENTITY_INDEX_BITS);
+}
+
+constexpr entityid makeEntityId(entityid index, uint8_t generation) {
+    return (entityid(generation) << ENTITY_INDEX_BITS) | index;
+}
+
+// Entity records live in pages of this many slots, allocated on demand.
+constexpr inline std::size_t DIRECTORY_PAGE_SLOTS = 1024;
+
+// Archetype position as stored in an entity record; the largest value marks a free slot.
+using archetypeindex = uint16_t;
+constexpr inline archetypeindex NULL_ARCHETYPE_INDEX = std::numeric_limits<archetypeindex>::max();
+
+// Rows every archetype reserves up front.
+constexpr inline std::size_t INITIAL_ARCHETYPE_CAPACITY = 128;
+
+// Target working set of a single parallel iteration range (roughly L1 sized).
+constexpr inline std::size_t PARALLEL_RANGE_BYTES = 16 * 1024;
+
+// Component columns start on cache line boundaries.
+constexpr inline std::size_t COLUMN_ALIGNMENT = 64;
+
+// Default chunk size for chunked archetype storage.
+constexpr inline std::size_t DEFAULT_CHUNK_BYTES = 16 * 1024;
+
+// Event types a program can use: event ids are process wide, shared by every
+// ecs, and a world's channel table is paged by EVENT_PAGE_SLOTS ids, so it
+// only allocates pages for ids it uses. DEFAULT_EVENT_CAPACITY is the events
+// a channel holds per step before it grows (see events.hpp).
+constexpr inline std::size_t EVENT_PAGE_SLOTS = 64;
+constexpr inline std::size_t MAX_EVENT_TYPES = 64 * EVENT_PAGE_SLOTS;
+constexpr inline std::size_t DEFAULT_EVENT_CAPACITY = 1024;
+
+// Rows sharing one change tick per column in vector storage (chunked storage
+// tracks whole chunks).
+constexpr inline std::size_t CHANGE_BLOCK_ROWS = 256;
+
+// Runtime id per component type, used where component sets have to be compared
+// at runtime (e.g. system access declarations). Ids are dense and process local.
+using componentid = uint32_t;
+
+inline std::atomic<componentid> nextComponentId{0};
+
+template<typename T>
+componentid componentId() {
+    if constexpr (!std::is_same_v<T, std::remove_cv_t<T>>) {
+        return componentId<std::remove_cv_t<T>>();
+    } else {
+        static const componentid id = nextComponentId.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+}
+
+// Position of T in a type pack.
+template<typename T, typename First, typename ...Rest>
+constexpr std::size_t typeIndex() {
+    if constexpr (std::is_same_v<T, First>) {
+        return 0;
+    } else {
+        static_assert(sizeof...(Rest) > 0, "Type not in pack");
+        return 1 + typeIndex<T, Rest...>();
+    }
+}
+
+// Field-level (SoA) layout opt-in. List every data member of a component:
+//   template<> struct soaFields<Position> {
+//       static constexpr auto members = std::tuple{&Position::x, &Position::y};
+//   };
+// then wrap it in an archetype to store one array per field instead of an
+// array of structs: archetype<soa<Position>, soa<Velocity>> (see soa.hpp).
+template<typename T>
+struct soaFields;
+
+template<typename T>
+struct soa {};
 
 // Example component types
 struct Position {
@@ -35,14 +120,28 @@ struct Velocity { // Needs to be units/sec
     float dx, dy;
 };
 
+template<>
+struct soaFields<Position> {
+    static constexpr auto members = std::tuple{&Position::x, &Position::y};
+};
+
+template<>
+struct soaFields<Velocity> {
+    static constexpr auto members = std::tuple{&Velocity::dx, &Velocity::dy};
+};
+
 struct Lifetime {
-    float ttl;
+    float ttl;              // Seconds to live, counted from when LifetimeSystem first sees it
+    uint32_t expiresAt = 0; // Absolute tick set by LifetimeSystem, 0 until then
 };
 
 struct EColor {
     size_t col;
 };
 
+// Tag: entities that never move (see query without<Static>).
+struct Static {};
+
 struct AABB {
     float xmin, xmax, ymin, ymax;
 };
@@ -0,0 +1,550 @@
+// Headless ECS core benchmarks with machine-readable output.
+// Usage: gxe_ecs_bench [--sizes 10000,100000] [--reps 3] [--threads 1] [--out results.json]
+//
+// Every case reports the best of `reps` runs as ns per entity, plus the heap
+// allocations (count and bytes) made inside the timed region of that run.
+
+#include "archetype_ecs/ecs.hpp"
+#include "archetype_ecs/stepper.hpp"
+#include "archetype_ecs/systems/lifetime.hpp"
+#include "archetype_ecs/systems/physics.hpp"
+#include "archetype_ecs/systems/render.hpp"
+#include "archetype_ecs/types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+// Allocation counting: every global new in the process goes through here.
+namespace {
+std::atomic<size_t> g_allocations{0};
+std::atomic<size_t> g_allocatedBytes{0};
+
+void* countedAlloc(size_t size, size_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void* ptr = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size > 0 ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+} // namespace
+
+void* operator new(size_t size) { return countedAlloc(size, 0); }
+void* operator new[](size_t size) { return countedAlloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return countedAlloc(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return countedAlloc(size, size_t(al)); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace {
+
+using namespace gxe;
+
+volatile float g_sink = 0.0f; // Keeps measured reads alive
+
+struct sample {
+    double ns = 0.0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+// Time func() and count the allocations it makes.
+template<typename Func>
+sample measure(Func&& func) {
+    size_t allocations = g_allocations.load();
+    size_t bytes = g_allocatedBytes.load();
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return sample{elapsed.count(), g_allocations.load() - allocations, g_allocatedBytes.load() - bytes};
+}
+
+Position makePosition(size_t i) {
+    return Position{float(i % 1024), float(i / 1024)};
+}
+
+Velocity makeVelocity(size_t i) {
+    return Velocity{1.0f, float(i % 7)};
+}
+
+// Archetype mixes. create() places entity i; all archetypes hold Position and Velocity.
+struct singleMix {
+    static constexpr const char* name = "single";
+    using moving = archetype<Position, Velocity>;
+    using world = ecs<moving>;
+
+    static entityid create(world& w, size_t i) {
+        return w.createEntity<moving>(makePosition(i), makeVelocity(i));
+    }
+};
+
+struct mixedMix {
+    static constexpr const char* name = "mixed";
+    using moving = archetype<Position, Velocity>;
+    using mortal = archetype<Position, Velocity, Lifetime>;
+    using colored = archetype<Position, Velocity, EColor>;
+    using full = archetype<Position, Velocity, Lifetime, EColor>;
+    using world = ecs<moving, mortal, colored, full>;
+
+    static entityid create(world& w, size_t i) {
+        switch (i % 4) {
+            case 0: return w.createEntity<moving>(makePosition(i), makeVelocity(i));
+            case 1: return w.createEntity<mortal>(makePosition(i), makeVelocity(i), Lifetime{1.0f});
+            case 2: return w.createEntity<colored>(makePosition(i), makeVelocity(i), EColor{i});
+            default: return w.createEntity<full>(makePosition(i), makeVelocity(i), Lifetime{1.0f}, EColor{i});
+        }
+    }
+};
+
+struct chunkedMix {
+    static constexpr const char* name = "chunked";
+    using moving = archetype<chunked<>, Position, Velocity>;
+    using world = ecs<moving>;
+
+    static entityid create(world& w, size_t i) {
+        return w.createEntity<moving>(makePosition(i), makeVelocity(i));
+    }
+};
+
+struct soaMix {
+    static constexpr const char* name = "soa";
+    using moving = archetype<soa<Position>, soa<Velocity>>;
+    using world = ecs<moving>;
+
+    static entityid create(world& w, size_t i) {
+        return w.createEntity<moving>(makePosition(i), makeVelocity(i));
+    }
+};
+
+struct options {
+    std::vector<size_t> sizes{10'000, 100'000, 1'000'000, 10'000'000};
+    size_t reps = 3;
+    size_t threads = 1;
+    const char* out = nullptr;
+};
+
+struct result {
+    std::string name;
+    std::string mix;
+    size_t entities;
+    sample best;
+};
+
+class runner {
+public:
+    explicit runner(const options& opts) : _opts(opts) {}
+
+    template<typename Mix>
+    void run() {
+        for (size_t n : _opts.sizes) {
+            benchCreate<Mix>(n);
+            benchChurn<Mix>(n);
+            benchIterate<Mix>(n);
+            benchLookup<Mix>(n);
+            benchPhysics<Mix>(n);
+            benchPhysicsSubsteps<Mix>(n);
+            benchPipeline<Mix>(n);
+            benchLifetime<Mix>(n);
+            benchEvents<Mix>(n);
+            benchExtract<Mix>(n);
+            benchOverlap<Mix>(n);
+            benchCheckpoint<Mix>(n);
+        }
+    }
+
+    void write(std::FILE* out) const {
+        std::fprintf(out, "{\n  \"threads\": %zu,\n  \"reps\": %zu,\n  \"results\": [\n", _opts.threads, _opts.reps);
+        for (size_t i = 0; i < _results.size(); ++i) {
+            const result& r = _results[i];
+            std::fprintf(out,
+                "    {\"name\": \"%s\", \"mix\": \"%s\", \"entities\": %zu, \"ns_per_entity\": %.4f, "
+                "\"allocations\": %zu, \"allocated_bytes\": %zu}%s\n",
+                r.name.c_str(), r.mix.c_str(), r.entities, r.best.ns / double(r.entities),
+                r.best.allocations, r.best.bytes, i + 1 < _results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    template<typename Mix>
+    std::vector<entityid> populate(typename Mix::world& w, size_t n) {
+        std::vector<entityid> ids(n);
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = Mix::create(w, i);
+        }
+        return ids;
+    }
+
+    // Run setup() + timed body() reps times and keep the fastest run.
+    template<typename Mix, typename Body>
+    void repeat(const char* name, size_t n, Body&& body) {
+        sample best;
+        for (size_t r = 0; r < _opts.reps; ++r) {
+            sample s = body();
+            if (r == 0 || s.ns < best.ns) {
+                best = s;
+            }
+        }
+        _results.push_back(result{name, Mix::name, n, best});
+        std::fprintf(stderr, "%-8s %-8s %10zu  %8.3f ns/entity\n", name, Mix::name, n, best.ns / double(n));
+    }
+
+    // createEntity into an empty world.
+    template<typename Mix>
+    void benchCreate(size_t n) {
+        repeat<Mix>("create", n, [&] {
+            typename Mix::world w(_opts.threads);
+            return measure([&] {
+                for (size_t i = 0; i < n; ++i) {
+                    Mix::create(w, i);
+                }
+            });
+        });
+    }
+
+    // destroyEntity on half the entities in random order, then refill the freed slots.
+    template<typename Mix>
+    void benchChurn(size_t n) {
+        repeat<Mix>("churn", n, [&] {
+            typename Mix::world w(_opts.threads);
+            std::vector<entityid> ids = populate<Mix>(w, n);
+            std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+            ids.resize(n / 2);
+            return measure([&] {
+                for (entityid id : ids) {
+                    w.destroyEntity(id);
+                }
+                for (size_t i = 0; i < ids.size(); ++i) {
+                    Mix::create(w, i);
+                }
+            });
+        });
+    }
+
+    // One forEachWithComponents pass over Position and Velocity.
+    template<typename Mix>
+    void benchIterate(size_t n) {
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        repeat<Mix>("iterate", n, [&] {
+            return measure([&] {
+                float sum = 0.0f;
+                w.template forEachWithComponents<Position, Velocity>([&sum](Position& pos, Velocity& vel) {
+                    sum += pos.x * vel.dx;
+                });
+                g_sink = sum;
+            });
+        });
+    }
+
+    // getComponent<Position> for every entity in random order.
+    template<typename Mix>
+    void benchLookup(size_t n) {
+        typename Mix::world w(_opts.threads);
+        std::vector<entityid> ids = populate<Mix>(w, n);
+        std::shuffle(ids.begin(), ids.end(), std::mt19937(7));
+        repeat<Mix>("lookup", n, [&] {
+            return measure([&] {
+                float sum = 0.0f;
+                for (entityid id : ids) {
+                    Position pos = w.template getComponent<Position>(id);
+                    sum += pos.x;
+                }
+                g_sink = sum;
+            });
+        });
+    }
+
+    // One world step running PhysicsSystem.
+    template<typename Mix>
+    void benchPhysics(size_t n) {
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        w.template registerSystem<PhysicsSystem>();
+        w.step(1.0f / 60.0f);
+        repeat<Mix>("physics", n, [&] {
+            return measure([&] {
+                w.step(1.0f / 60.0f);
+            });
+        });
+    }
+
+    // One world step of a 60 Hz PhysicsSystem that is 4 ticks behind: the
+    // substeps run fused in one pass (compare with 4x physics).
+    template<typename Mix>
+    void benchPhysicsSubsteps(size_t n) {
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        w.template registerSystem<PhysicsSystem>(60u);
+        w.step(1.0f / 60.0f);
+        repeat<Mix>("physics4", n, [&] {
+            return measure([&] {
+                w.step(4.0f / 60.0f);
+            });
+        });
+    }
+
+    // physics through a static pipeline (direct calls, no vtable).
+    template<typename Mix>
+    void benchPipeline(size_t n) {
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        typename Mix::world::template pipeline<PhysicsSystem> systems(w);
+        systems.step(1.0f / 60.0f);
+        repeat<Mix>("pipeline", n, [&] {
+            return measure([&] {
+                systems.step(1.0f / 60.0f);
+            });
+        });
+    }
+
+    // One world step of LifetimeSystem with n lifetimes filed and 1% of them
+    // expiring in the step (mixes with a Lifetime archetype only). Should cost
+    // like the expiries, not the population.
+    template<typename Mix>
+    void benchLifetime(size_t n) {
+        if constexpr (requires { typename Mix::mortal; }) {
+            repeat<Mix>("lifetime", n, [&] {
+                typename Mix::world w(_opts.threads);
+                w.template registerSystem<LifetimeSystem>(64u);
+                for (size_t i = 0; i < n; ++i) {
+                    float ttl = i % 100 == 0 ? 2.0f / 64.0f : 10.0f;
+                    w.template createEntity<typename Mix::mortal>(makePosition(i), makeVelocity(i), Lifetime{ttl});
+                }
+                w.step(1.0f / 64.0f); // File the lifetimes
+                return measure([&] {
+                    w.step(1.0f / 64.0f);
+                });
+            });
+        }
+    }
+
+    // One event per entity sent from a parallel loop, then a step and a pass
+    // over the batch. After the first run the channel no longer allocates.
+    template<typename Mix>
+    void benchEvents(size_t n) {
+        struct hit {
+            entityid id;
+        };
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        auto& channel = w.template events<hit>();
+        repeat<Mix>("events", n, [&] {
+            return measure([&] {
+                w.template forEachWithComponentsParallel<const Position>([&channel](entityid id, const Position&) {
+                    channel.send(hit{id});
+                });
+                w.step(0.0f);
+                entityid sum = 0;
+                for (const hit& h : channel.read()) {
+                    sum += h.id;
+                }
+                g_sink = float(sum);
+            });
+        });
+    }
+
+    // RenderExtractSystem: a full rebuild (gather + sort by color), then a
+    // step where physics moved everything, which only patches positions.
+    // Mixes with an EColor archetype only.
+    template<typename Mix>
+    void benchExtract(size_t n) {
+        if constexpr (requires { typename Mix::colored; }) {
+            typename Mix::world w(_opts.threads);
+            populate<Mix>(w, n);
+            w.template forEachWithComponents<EColor>([](EColor& color) {
+                color.col %= 21; // The palette size of main.cpp
+            });
+            auto& extract = w.template registerSystem<RenderExtractSystem>();
+            w.step(1.0f / 60.0f);
+            repeat<Mix>("extract", n, [&] {
+                return measure([&] {
+                    extract.rebuild();
+                });
+            });
+
+            w.template registerSystem<PhysicsSystem>();
+            w.step(1.0f / 60.0f);
+            repeat<Mix>("extractpatch", n, [&] {
+                return measure([&] {
+                    w.step(1.0f / 60.0f);
+                });
+            });
+        }
+    }
+
+    // A frame of physics plus a stand-in render pass over every Position:
+    // back to back ("frame"), then through overlappedStepper ("overlap"),
+    // which renders the previous step's snapshot while the next one runs.
+    // Overlap needs --threads > 1 and spare cores.
+    template<typename Mix>
+    void benchOverlap(size_t n) {
+        static constexpr size_t FRAMES = 8;
+        auto render = [](std::span<const Position> positions) {
+            float sum = 0.0f;
+            for (const Position& pos : positions) {
+                sum += std::sqrt(pos.x * pos.x + pos.y * pos.y);
+            }
+            g_sink = sum;
+        };
+
+        typename Mix::world w(_opts.threads);
+        populate<Mix>(w, n);
+        w.template registerSystem<PhysicsSystem>();
+        std::vector<Position> positions;
+        positions.reserve(n);
+        repeat<Mix>("frame", n, [&] {
+            return measure([&] {
+                for (size_t f = 0; f < FRAMES; ++f) {
+                    w.step(1.0f / 60.0f);
+                    positions.clear();
+                    w.template forEachWithComponents<const Position>([&positions](const Position& pos) {
+                        positions.push_back(pos);
+                    });
+                    render(positions);
+                }
+            });
+        });
+
+        overlappedStepper<typename Mix::world, Position> stepper(w);
+        stepper.step(1.0f / 60.0f);
+        stepper.step(1.0f / 60.0f); // Both snapshot buffers sized
+        repeat<Mix>("overlap", n, [&] {
+            return measure([&] {
+                for (size_t f = 0; f < FRAMES; ++f) {
+                    render(stepper.step(1.0f / 60.0f).template column<Position>());
+                }
+            });
+        });
+        stepper.sync();
+    }
+
+    // ecs::checkpoint() after writing Position on the first 0%, 1%, 10% and 100%
+    // of the entities since the previous checkpoint. Cost should follow the
+    // changed share, not the world size. Changes are tracked per block of rows,
+    // so writes scattered over every block cost like the 100% case.
+    template<typename Mix>
+    void benchCheckpoint(size_t n) {
+        typename Mix::world w(_opts.threads);
+        std::vector<entityid> ids = populate<Mix>(w, n);
+
+        static constexpr std::pair<const char*, size_t> shares[] = {
+            {"checkpoint0", 0}, {"checkpoint1", 1}, {"checkpoint10", 10}, {"checkpoint100", 100}};
+        for (auto [name, percent] : shares) {
+            size_t changed = n * percent / 100;
+            repeat<Mix>(name, n, [&] {
+                w.checkpoint();
+                for (size_t i = 0; i < changed; ++i) {
+                    Position pos = w.template getComponent<Position>(ids[i]);
+                    pos.x += 1.0f;
+                    w.template getComponent<Position>(ids[i]) = pos;
+                }
+                return measure([&] {
+                    w.checkpoint();
+                });
+            });
+        }
+    }
+
+    const options& _opts;
+    std::vector<result> _results;
+};
+
+// Parse a positive count; false if text is not entirely digits (or is 0).
+bool parseCount(const char* text, size_t& out) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || *text == '-' || value == 0) {
+        return false;
+    }
+    out = size_t(value);
+    return true;
+}
+
+// Comma separated counts, e.g. "10000,100000".
+bool parseSizes(const char* list, std::vector<size_t>& sizes) {
+    sizes.clear();
+    std::string text(list);
+    for (size_t begin = 0; begin <= text.size();) {
+        size_t end = std::min(text.find(',', begin), text.size());
+        size_t size = 0;
+        if (!parseCount(text.substr(begin, end - begin).c_str(), size)) {
+            return false;
+        }
+        sizes.push_back(size);
+        begin = end + 1;
+    }
+    return true;
+}
+
+void printUsage(std::FILE* out) {
+    std::fprintf(out, "usage: gxe_ecs_bench [--sizes 10000,100000] [--reps 3] [--threads 1] [--out results.json]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    options opts;
+    for (int i = 1; i < argc; i += 2) {
+        if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            printUsage(stdout);
+            return 0;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = value != nullptr;
+        if (std::strcmp(argv[i], "--sizes") == 0) {
+            ok = ok && parseSizes(value, opts.sizes);
+        } else if (std::strcmp(argv[i], "--reps") == 0) {
+            ok = ok && parseCount(value, opts.reps);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            ok = ok && parseCount(value, opts.threads);
+        } else if (std::strcmp(argv[i], "--out") == 0) {
+            opts.out = value;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            printUsage(stderr);
+            return 1;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "invalid or missing value for %s\n", argv[i]);
+            printUsage(stderr);
+            return 1;
+        }
+    }
+
+    runner bench(opts);
+    bench.run<singleMix>();
+    bench.run<mixedMix>();
+    bench.run<chunkedMix>();
+    bench.run<soaMix>();
+
+    std::FILE* out = opts.out ? std::fopen(opts.out, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", opts.out);
+        return 1;
+    }
+    bench.write(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Compares PhysicsSystem over array-of-structs and field-level (SoA) layouts.
+// Usage: gxe_physics_bench [entities] [ticks]
+
+#include "archetype_ecs/ecs.hpp"
+#include "archetype_ecs/systems/physics.hpp"
+#include "archetype_ecs/types.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using namespace gxe;
+
+template<typename Archetype>
+double nsPerEntity(size_t entities, size_t ticks) {
+    ecs<Archetype> world(1); // Single thread: measure the kernel, not the pool
+    world.template createEntities<Archetype>(entities, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i % 1024), float(i / 1024)};
+        vel = Velocity{1.0f, float(i % 7)};
+    });
+    world.template registerSystem<PhysicsSystem>();
+    world.step(1.0f / 60.0f); // Warm up
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < ticks; ++t) {
+        world.step(1.0f / 60.0f);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(entities * ticks);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t entities = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t ticks = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+
+    double aos = nsPerEntity<archetype<Position, Velocity>>(entities, ticks);
+    double soa = nsPerEntity<archetype<gxe::soa<Position>, gxe::soa<Velocity>>>(entities, ticks);
+
+    std::printf("entities %zu, ticks %zu\n", entities, ticks);
+    std::printf("aos  %8.3f ns/entity\n", aos);
+    std::printf("soa  %8.3f ns/entity (%.2fx)\n", soa, aos / soa);
+    return 0;
+}
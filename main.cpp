@@ -1,10 +1,14 @@
 #include "archetype_ecs/ecs.hpp"
+#include "archetype_ecs/stepper.hpp"
+#include "archetype_ecs/systems/lifetime.hpp"
 #include "archetype_ecs/systems/physics.hpp"
+#include "archetype_ecs/systems/render.hpp"
 #include "archetype_ecs/types.hpp"
 
 #include <array>
 #include <iostream>
 #include <cstdlib>
+#include <span>
 
 #include <raylib.h>
 
@@ -13,7 +17,7 @@
 
 int main() {
     using namespace gxe;
-    using StaticEntity = archetype<Position, Velocity, Lifetime, EColor>;
+    using StaticEntity = archetype<soa<Position>, soa<Velocity>, Lifetime, EColor>; // SoA: SIMD physics
     // using PhsyicsEntity = archetype<Position, Velocity, Hitbox2D, EColor>;
 
     constexpr size_t COLOR_COUNT = 21;
@@ -25,6 +29,9 @@ int main() {
 
     ecs<StaticEntity> ecs;
     ecs.registerSystem<PhysicsSystem>();
+    ecs.registerSystem<LifetimeSystem>(); // Destroys entities once their Lifetime runs out
+    auto& extract = ecs.registerSystem<RenderExtractSystem>(); // Draw data, sorted by color
+    overlappedStepper<decltype(ecs)> stepper(ecs); // Simulates the next frame while this one is drawn
 
     std::cout << "Created systems" << std::endl;
 
@@ -43,7 +50,7 @@ int main() {
 
     std::srand(std::time({}));
     while(!WindowShouldClose()){
-        ecs.step(); // Step the ecs
+        stepper.sync(); // Previous step done, the world is ours again
 
         if(IsMouseButtonDown(MOUSE_LEFT_BUTTON)){ // Spawn an entity.
             Vector2 mPos = GetMousePosition();
@@ -60,26 +67,26 @@ int main() {
             );
         }
 
+        // The extracted array stays valid while the next step fills the other buffer
+        std::span<const renderInstance> instances = extract.instances();
+        stepper.launch(GetFrameTime());
+
         // Render Logic
         BeginDrawing(); // Tell raylib we are drawing
         ClearBackground(WHITE);
 
-        ecs.forEachWithComponents<Position, Lifetime, EColor>([&ecs, &circleTex, &colors](entityid id, Position& pos, Lifetime& lt, EColor& ecol){
+        for(const renderInstance& inst : instances){
             DrawTexture(circleTex.texture,
-                pos.x - circleTex.texture.width / 2.0f,
-                pos.y - circleTex.texture.height / 2.0f,
-                colors[ecol.col]
+                inst.x - circleTex.texture.width / 2.0f,
+                inst.y - circleTex.texture.height / 2.0f,
+                colors[inst.key]
             );
-
-            lt.ttl -= GetFrameTime();
-            if(lt.ttl <= 0){
-                ecs.destroyEntity(id);
-            }
-        });
+        }
 
         EndDrawing(); // Finish drawing commands
     }
 
+    stepper.sync();
     CloseWindow();
     
     return EXIT_SUCCESS;
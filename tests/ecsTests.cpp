@@ -0,0 +1,1391 @@
+// Headless correctness checks for the ECS core, run by ctest.
+// Usage: gxe_ecs_tests [name...]   (no names: run every test)
+
+#include "archetype_ecs/ecs.hpp"
+#include "archetype_ecs/systems/lifetime.hpp"
+#include "archetype_ecs/systems/physics.hpp"
+#include "archetype_ecs/systems/render.hpp"
+#include "archetype_ecs/systems/spatial.hpp"
+#include "archetype_ecs/stepper.hpp"
+#include "archetype_ecs/types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace gxe;
+
+int g_failures = 0;
+
+// Record a failure and keep going, so one run reports every broken check.
+#define CHECK(...)                                                                       \
+    do {                                                                                 \
+        if (!(__VA_ARGS__)) {                                                            \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+            ++g_failures;                                                                \
+        }                                                                                \
+    } while (0)
+
+using moving = archetype<Position, Velocity>;
+using mortal = archetype<Position, Velocity, Lifetime>;
+using colored = archetype<Position, EColor>;
+
+// Parallel iteration visits every matching row exactly once across all
+// archetypes and its writes land: the sums match a serial pass.
+void testParallelForEach() {
+    ecs<moving, colored> world(4);
+    constexpr size_t MOVING = 100000;
+    constexpr size_t COLORED = 3000;
+    world.createEntities<moving>(MOVING, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i % 1000), 0.0f};
+        vel = Velocity{1.0f, 0.0f};
+    });
+    world.createEntities<colored>(COLORED, [](size_t i, Position& pos, EColor& color) {
+        pos = Position{float(i % 7), 0.0f};
+        color = EColor{i};
+    });
+
+    uint64_t serial = 0;
+    world.forEachWithComponents<const Position>([&serial](const Position& pos) {
+        serial += uint64_t(pos.x);
+    });
+
+    for (size_t grain : {size_t(0), size_t(1), size_t(97), size_t(1 << 20)}) {
+        std::atomic<uint64_t> sum{0};
+        std::atomic<size_t> rows{0};
+        world.forEachWithComponentsParallel<const Position>([&](entityid, const Position& pos) {
+            sum.fetch_add(uint64_t(pos.x), std::memory_order_relaxed);
+            rows.fetch_add(1, std::memory_order_relaxed);
+        }, grain);
+        CHECK(rows.load() == MOVING + COLORED);
+        CHECK(sum.load() == serial);
+    }
+
+    world.forEachWithComponentsParallel<Position>([](entityid id, Position& pos) {
+        pos.y = float(entityIndex(id));
+    }, 128);
+    size_t wrong = 0;
+    world.forEachWithComponents<const Position>([&wrong](entityid id, const Position& pos) {
+        wrong += pos.y != float(entityIndex(id));
+    });
+    CHECK(wrong == 0);
+}
+
+// Shared by the systems of the scheduler test: how many of them are inside
+// tick() touching Position, the most seen at once, and the order they ran.
+struct accessProbe {
+    std::atomic<int> active{0};
+    std::atomic<int> peak{0};
+    std::mutex mutex;
+    std::vector<int> order;
+
+    void enter(int tag) {
+        int now = active.fetch_add(1) + 1;
+        int seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+        }
+        std::lock_guard lock(mutex);
+        order.push_back(tag);
+    }
+
+    void leave() { active.fetch_sub(1); }
+};
+
+// Adds `tag` to every Position.x, or only reads them, depending on Access.
+template<typename ECS, typename Access>
+class PositionToucher : public SystemCRTP<PositionToucher<ECS, Access>, ECS, Access> {
+public:
+    PositionToucher(ECS& world, accessProbe& probe, int tag)
+        : SystemCRTP<PositionToucher<ECS, Access>, ECS, Access>(world), _probe(probe), _tag(tag) {}
+
+    void tick(float) override {
+        _probe.enter(_tag);
+        if constexpr (std::is_same_v<Access, writes<Position>>) {
+            this->_world.template forEachWithComponents<Position>([this](Position& pos) { pos.x += float(_tag); });
+        } else {
+            float sum = 0.0f;
+            this->_world.template forEachWithComponents<const Position>([&sum](const Position& pos) { sum += pos.x; });
+            sink = sum;
+        }
+        _probe.leave();
+    }
+
+    float sink = 0.0f;
+
+private:
+    accessProbe& _probe;
+    int _tag;
+};
+
+template<typename ECS>
+using PositionWriter = PositionToucher<ECS, writes<Position>>;
+template<typename ECS>
+using PositionReader = PositionToucher<ECS, reads<Position>>;
+
+// Scales every Velocity: conflicts with none of the Position systems.
+template<typename ECS>
+class VelocityWriter : public SystemCRTP<VelocityWriter<ECS>, ECS, writes<Velocity>> {
+public:
+    explicit VelocityWriter(ECS& world) : SystemCRTP<VelocityWriter<ECS>, ECS, writes<Velocity>>(world) {}
+
+    void tick(float) override {
+        this->_world.template forEachWithComponents<Velocity>([](Velocity& vel) { vel.dx += 1.0f; });
+    }
+};
+
+// Systems that touch Position with at least one writer never run at the
+// same time and keep their registration order; all of them still run.
+void testSystemSchedule() {
+    ecs<moving> world(4);
+    world.createEntities<moving>(20000, [](size_t, Position& pos, Velocity& vel) {
+        pos = Position{};
+        vel = Velocity{};
+    });
+    accessProbe probe;
+    world.registerSystem<PositionWriter>(probe, 1);
+    world.registerSystem<VelocityWriter>();
+    world.registerSystem<PositionReader>(probe, 2);
+    world.registerSystem<VelocityWriter>();
+    world.registerSystem<PositionWriter>(probe, 3);
+
+    constexpr int STEPS = 50;
+    for (int i = 0; i < STEPS; ++i) {
+        world.step(0.0f);
+    }
+    CHECK(probe.peak.load() == 1);
+    CHECK(probe.order.size() == size_t(3 * STEPS));
+    bool ordered = true;
+    for (size_t i = 0; i < probe.order.size(); ++i) {
+        ordered = ordered && probe.order[i] == int(i % 3) + 1;
+    }
+    CHECK(ordered);
+
+    size_t wrong = 0;
+    world.forEachWithComponents<const Position, const Velocity>([&wrong](const Position& pos, const Velocity& vel) {
+        wrong += pos.x != float(4 * STEPS) || vel.dx != float(2 * STEPS);
+    });
+    CHECK(wrong == 0);
+}
+
+// On its first run, replaces every moving entity with an odd x by a colored
+// one, recording both from pool workers while iterating.
+template<typename ECS>
+class Recolor : public SystemCRTP<Recolor<ECS>, ECS, reads<Position, Velocity>> {
+public:
+    explicit Recolor(ECS& world) : SystemCRTP<Recolor<ECS>, ECS, reads<Position, Velocity>>(world) {}
+
+    void tick(float) override {
+        if (ran++) {
+            return;
+        }
+        this->_world.template forEachQueryParallel<query<const Position, const Velocity>>(
+            [this](entityid id, const Position& pos, const Velocity&) {
+                if (int(pos.x) % 2 == 1) {
+                    auto& commands = this->_world.commands();
+                    commands.destroy(id);
+                    commands.destroy(id); // Twice is harmless
+                    commands.template create<colored>(Position{pos.x, 1.0f}, EColor{1});
+                }
+            }, 64);
+        rowsDuring = this->_world.template queryCount<query<Position>>();
+    }
+
+    int ran = 0;
+    size_t rowsDuring = 0;
+};
+
+// Creates and destroys recorded while iterating are applied at the end of the
+// step, once, and not before.
+void testCommandBuffers() {
+    ecs<moving, colored> world(4);
+    std::vector<entityid> ids(10000);
+    world.createEntities<moving>(ids.size(), [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i), 0.0f};
+        vel = Velocity{};
+    }, ids);
+    auto& recolor = world.registerSystem<Recolor>();
+    world.step(0.0f);
+
+    CHECK(recolor.rowsDuring == ids.size());
+    CHECK(world.entityCount() == ids.size());
+    CHECK(world.queryCount<query<Velocity>>() == ids.size() / 2);
+    CHECK(world.queryCount<query<EColor>>() == ids.size() / 2);
+    size_t wrong = 0;
+    world.forEachWithComponents<const Position>([&wrong](const Position& pos) {
+        wrong += (int(pos.x) % 2 == 1) != (pos.y == 1.0f);
+    });
+    CHECK(wrong == 0);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        wrong += world.isValid(ids[i]) != (i % 2 == 0);
+    }
+    CHECK(wrong == 0);
+
+    // From the driving thread: nothing happens until the flush.
+    world.commands().destroy(ids[0]);
+    world.commands().create<moving>(Position{}, Velocity{});
+    CHECK(world.isValid(ids[0]));
+    CHECK(world.entityCount() == ids.size());
+    world.flushCommands();
+    CHECK(!world.isValid(ids[0]));
+    CHECK(world.entityCount() == ids.size());
+    world.step(0.0f);
+    CHECK(world.entityCount() == ids.size());
+}
+
+// Components in chunked<> storage stay where they are while the archetype
+// grows, one entity or one batch at a time.
+void testChunkedAddresses() {
+    using particle = archetype<chunked<>, Position, Velocity>;
+    ecs<particle> world(1);
+    std::vector<entityid> ids;
+    std::vector<const Position*> addresses;
+    for (int i = 0; i < 100; ++i) {
+        ids.push_back(world.createEntity<particle>(Position{float(i), 0.0f}, Velocity{}));
+        addresses.push_back(&world.getComponent<particle, const Position>(ids.back()));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        world.createEntity<particle>(Position{}, Velocity{});
+    }
+    world.createEntities<particle>(10000, [](size_t, Position&, Velocity&) {});
+
+    size_t moved = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const Position* now = &world.getComponent<particle, const Position>(ids[i]);
+        moved += now != addresses[i] || now->x != float(i);
+    }
+    CHECK(moved == 0);
+}
+
+// Adding or removing a component with no registered target archetype fails
+// and leaves the entity where it was, as does a stale handle.
+void testMissingEdge() {
+    ecs<moving, mortal, colored> world(1);
+    entityid id = world.createEntity<moving>(Position{1.0f, 2.0f}, Velocity{3.0f, 4.0f});
+
+    CHECK(!world.addComponent(id, EColor{5}));     // No <Position, Velocity, EColor>
+    CHECK(!world.removeComponent<Velocity>(id));   // No <Position>
+    CHECK(!world.removeComponent<Lifetime>(id));   // Not held
+    CHECK(world.getEntityArchetypeIndex(id) == 0);
+    CHECK(world.getComponent<moving, Position>(id).x == 1.0f);
+
+    CHECK(world.addComponent(id, Lifetime{1.0f}));
+    CHECK(world.getEntityArchetypeIndex(id) == 1);
+    CHECK(world.getComponent<Velocity>(id).dy == 4.0f);
+    CHECK(world.removeComponent<Lifetime>(id));
+    CHECK(world.getEntityArchetypeIndex(id) == 0);
+
+    world.destroyEntity(id);
+    CHECK(!world.addComponent(id, Lifetime{1.0f}));
+    CHECK(!world.removeComponent<Velocity>(id));
+    CHECK(world.entityCount() == 0);
+}
+
+// A stale handle is rejected until its slot has been reused
+// ENTITY_GENERATIONS times; then the generation wraps and it names the new
+// owner again (the documented limit, see types.hpp).
+void testGenerationWrap() {
+    ecs<moving> world(1);
+    entityid stale = world.createEntity<moving>(Position{}, Velocity{});
+    world.destroyEntity(stale);
+
+    entityid current = NULL_ID;
+    entityid second = NULL_ID; // The handle of the first reuse
+    for (uint32_t reuse = 1; reuse < ENTITY_GENERATIONS; ++reuse) {
+        current = world.createEntity<moving>(Position{}, Velocity{});
+        CHECK(entityIndex(current) == entityIndex(stale));
+        CHECK(!world.isValid(stale));
+        world.destroyEntity(current);
+        second = reuse == 1 ? current : second;
+    }
+    current = world.createEntity<moving>(Position{}, Velocity{});
+    CHECK(current == stale);
+    CHECK(world.isValid(stale));
+
+    // Freed again, the slot carries the generation of the first reuse, whose
+    // handle must still be stale: destroying it changes nothing.
+    world.destroyEntity(current);
+    CHECK(entityGeneration(second) == 1);
+    CHECK(!world.isValid(second));
+    world.destroyEntity(second);
+    CHECK(world.entityCount() == 0);
+    entityid reused = world.createEntity<moving>(Position{}, Velocity{});
+    entityid grown = world.createEntity<moving>(Position{}, Velocity{});
+    CHECK(entityIndex(reused) == entityIndex(stale));
+    CHECK(entityIndex(grown) != entityIndex(stale));
+    CHECK(world.entityCount() == 2);
+
+    // With more free slots the FIFO free list hands out every other one first.
+    ecs<moving> churn(1);
+    entityid a = churn.createEntity<moving>(Position{}, Velocity{});
+    entityid b = churn.createEntity<moving>(Position{}, Velocity{});
+    churn.destroyEntity(a);
+    churn.destroyEntity(b);
+    CHECK(entityIndex(churn.createEntity<moving>(Position{}, Velocity{})) == entityIndex(a));
+    CHECK(entityIndex(churn.createEntity<moving>(Position{}, Velocity{})) == entityIndex(b));
+}
+
+// Bulk creation (generator and column spans) and bulk destruction leave the
+// world exactly as the same operations one entity at a time.
+void testBulkCreateDestroy() {
+    using world = ecs<moving, colored>;
+    world bulk(1);
+    world single(1);
+    constexpr size_t COUNT = 5000;
+
+    std::vector<entityid> bulkIds(COUNT);
+    bulk.createEntities<moving>(COUNT, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i), 1.0f};
+        vel = Velocity{float(i), 2.0f};
+    }, bulkIds);
+    std::vector<Position> positions;
+    std::vector<EColor> colors;
+    for (size_t i = 0; i < COUNT; ++i) {
+        positions.push_back(Position{float(i), 3.0f});
+        colors.push_back(EColor{i});
+    }
+    std::vector<entityid> colorIds(COUNT);
+    bulk.createEntities<colored>({positions, colors}, colorIds);
+    bulkIds.insert(bulkIds.end(), colorIds.begin(), colorIds.end());
+
+    std::vector<entityid> singleIds;
+    for (size_t i = 0; i < COUNT; ++i) {
+        singleIds.push_back(single.createEntity<moving>(Position{float(i), 1.0f}, Velocity{float(i), 2.0f}));
+    }
+    for (size_t i = 0; i < COUNT; ++i) {
+        singleIds.push_back(single.createEntity<colored>(positions[i], colors[i]));
+    }
+    CHECK(bulkIds == singleIds);
+
+    // Every third entity, some twice, plus a stale handle.
+    std::vector<entityid> doomed;
+    for (size_t i = 0; i < bulkIds.size(); i += 3) {
+        doomed.push_back(bulkIds[i]);
+    }
+    doomed.push_back(bulkIds[0]);
+    doomed.push_back(makeEntityId(entityIndex(bulkIds[1]), entityGeneration(bulkIds[1]) + 1));
+    bulk.destroyEntities(doomed);
+    for (entityid id : doomed) {
+        single.destroyEntity(id);
+    }
+
+    CHECK(bulk.entityCount() == single.entityCount());
+    CHECK(bulk.entityCount() == 2 * COUNT - (2 * COUNT + 2) / 3);
+    size_t wrong = 0;
+    for (size_t i = 0; i < bulkIds.size(); ++i) {
+        bool alive = i % 3 != 0;
+        wrong += bulk.isValid(bulkIds[i]) != alive;
+        if (alive) {
+            const Position& a = bulk.getComponent<const Position>(bulkIds[i]);
+            const Position& b = single.getComponent<const Position>(bulkIds[i]);
+            wrong += a.x != b.x || a.y != b.y;
+        }
+    }
+    CHECK(wrong == 0);
+
+    // Freed slots are reused by the next batch.
+    std::vector<entityid> again(10);
+    bulk.createEntities<moving>(again.size(), [](size_t, Position&, Velocity&) {}, again);
+    CHECK(std::all_of(again.begin(), again.end(), [](entityid id) { return entityGeneration(id) == 1; }));
+}
+
+// Chunk iteration hands every matching row over exactly once, as spans whose
+// ids line up with the columns, within one storage block for chunked<>
+// archetypes, and skipping without<> archetypes; writes through them land.
+void testChunkSpans() {
+    using particle = archetype<chunked<>, Position, Velocity>;
+    using pinned = archetype<Position, Velocity, Static>;
+    ecs<moving, particle, pinned> world(4);
+    world.createEntities<moving>(3000, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i), 0.0f};
+        vel = Velocity{1.0f, 0.0f};
+    });
+    world.createEntities<particle>(5000, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i), 0.0f};
+        vel = Velocity{2.0f, 0.0f};
+    });
+    world.createEntities<pinned>(100, [](size_t, Position& pos, Velocity& vel, Static&) {
+        pos = Position{};
+        vel = Velocity{5.0f, 0.0f};
+    });
+
+    size_t rows = 0;
+    size_t misaligned = 0;
+    size_t oversized = 0;
+    world.forEachChunk<Position, const Velocity, without<Static>>([&](auto pos, auto vel, std::span<const entityid> ids) {
+        rows += ids.size();
+        misaligned += pos.size() != ids.size() || vel.size() != ids.size();
+        oversized += vel[0].dx == 2.0f && ids.size() > particle::ROWS_PER_BLOCK;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            misaligned += &world.getComponent<const Position>(ids[i]) != &pos[i];
+            pos[i].y += vel[i].dx;
+        }
+    });
+    CHECK(rows == 8000);
+    CHECK(misaligned == 0);
+    CHECK(oversized == 0);
+
+    std::atomic<size_t> parallelRows{0};
+    world.forEachChunkParallel<Position, const Velocity>([&](auto pos, auto vel, std::span<const entityid> ids) {
+        parallelRows.fetch_add(ids.size(), std::memory_order_relaxed);
+        for (size_t i = 0; i < pos.size(); ++i) {
+            pos[i].y += vel[i].dx;
+        }
+    }, 100);
+    CHECK(parallelRows.load() == 8100);
+
+    size_t wrong = 0;
+    world.forEachWithComponents<const Position, const Velocity>([&wrong](const Position& pos, const Velocity& vel) {
+        float expected = vel.dx == 5.0f ? 5.0f : 2.0f * vel.dx;
+        wrong += pos.y != expected;
+    });
+    CHECK(wrong == 0);
+}
+
+// PhysicsSystem gives bit-identical results whether the archetype stores
+// structs or soa<> field arrays (SIMD kernel, with a scalar tail), with one
+// tick per step or several fused substeps.
+void testSoaPhysicsMatchesAos() {
+    using aos = archetype<Position, Velocity>;
+    using fields = archetype<soa<Position>, soa<Velocity>>;
+    ecs<aos> structs(4);
+    ecs<fields> arrays(4);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+    for (int i = 0; i < 10007; ++i) { // Not a multiple of the SIMD width
+        Position pos{value(rng), value(rng)};
+        Velocity vel{value(rng), value(rng)};
+        structs.createEntity<aos>(pos, vel);
+        arrays.createEntity<fields>(pos, vel);
+    }
+
+    auto compare = [&] {
+        std::vector<std::pair<Position, Velocity>> expected(structs.entityCount());
+        structs.forEachWithComponents<const Position, const Velocity>([&](entityid id, const Position& pos, const Velocity& vel) {
+            expected[entityIndex(id)] = {pos, vel};
+        });
+        size_t wrong = 0;
+        arrays.forEachWithComponents<const Position, const Velocity>([&](entityid id, const auto& posRef, const auto& velRef) {
+            Position pos = posRef;
+            Velocity vel = velRef;
+            const auto& [p, v] = expected[entityIndex(id)];
+            wrong += pos.x != p.x || pos.y != p.y || vel.dx != v.dx || vel.dy != v.dy;
+        });
+        return wrong == 0;
+    };
+
+    structs.registerSystem<PhysicsSystem>();
+    arrays.registerSystem<PhysicsSystem>();
+    for (int i = 0; i < 10; ++i) {
+        structs.step(1.0f / 60.0f);
+        arrays.step(1.0f / 60.0f);
+    }
+    CHECK(compare());
+
+    // Fixed rate, three ticks per step: the fused substep loops.
+    ecs<aos> fixedStructs(4);
+    ecs<fields> fixedArrays(4);
+    structs.forEachWithComponents<const Position, const Velocity>([&](const Position& pos, const Velocity& vel) {
+        fixedStructs.createEntity<aos>(pos, vel);
+        fixedArrays.createEntity<fields>(pos, vel);
+    });
+    Position start = fixedStructs.getComponent<const Position>(makeEntityId(0, 0));
+    fixedStructs.registerSystem<PhysicsSystem>(60u);
+    fixedArrays.registerSystem<PhysicsSystem>(60u);
+    for (int i = 0; i < 5; ++i) {
+        fixedStructs.step(3.0f / 60.0f);
+        fixedArrays.step(3.0f / 60.0f);
+    }
+    std::vector<Position> expected;
+    fixedStructs.forEachWithComponents<const Position>([&](const Position& pos) { expected.push_back(pos); });
+    size_t wrong = 0;
+    size_t row = 0;
+    fixedArrays.forEachWithComponents<const Position>([&](const auto& posRef) {
+        Position pos = posRef;
+        wrong += pos.x != expected[row].x || pos.y != expected[row].y;
+        ++row;
+    });
+    CHECK(row == expected.size());
+    CHECK(wrong == 0);
+    CHECK(expected[0].x != start.x || expected[0].y != start.y); // It moved
+}
+
+// Writes Position through getComponent from a parallel loop over Velocity and
+// counts the rows whose Position changed since its previous run.
+template<typename ECS>
+class NudgeSystem : public SystemCRTP<NudgeSystem<ECS>, ECS, reads<Velocity>, writes<Position>> {
+public:
+    explicit NudgeSystem(ECS& world) : SystemCRTP<NudgeSystem<ECS>, ECS, reads<Velocity>, writes<Position>>(world) {}
+
+    void tick(float) override {
+        seen = 0;
+        this->_world.template forEachWithComponents<const Position, changed<Position>>([this](const Position&) {
+            ++seen;
+        });
+        this->_world.template forEachWithComponentsParallel<const Velocity>([this](entityid id, const Velocity& vel) {
+            this->_world.template getComponent<Position>(id).x += vel.dx;
+        }, 1);
+    }
+
+    size_t seen = 0;
+};
+
+// Writes made through getComponent on pool workers carry the running system's
+// tick, so the system does not see them as changed on its next run, while
+// later systems and outside readers do.
+void testParallelGetComponentTick() {
+    ecs<moving> world(4);
+    world.createEntities<moving>(4096, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{0.0f, float(i)};
+        vel = Velocity{1.0f, 0.0f};
+    });
+    auto& nudge = world.registerSystem<NudgeSystem>();
+
+    world.step(0.0f);
+    CHECK(nudge.seen == 4096); // Everything is new
+    world.step(0.0f);
+    CHECK(nudge.seen == 0);    // Only its own writes happened since
+    world.step(0.0f);
+    CHECK(nudge.seen == 0);
+
+    size_t moved = 0;
+    world.forEachWithComponents<const Position, changed<Position>>([&moved](const Position& pos) {
+        moved += pos.x == 3.0f;
+    });
+    CHECK(moved == 4096);
+}
+
+// Snapshots whose entity directory does not match the archetype rows are
+// rejected and leave the world empty, instead of loading dangling records.
+void testSnapshotValidation() {
+    using world = ecs<moving, mortal>;
+    world source(1);
+    std::vector<entityid> ids;
+    for (int i = 0; i < 4; ++i) {
+        ids.push_back(source.createEntity<moving>(Position{float(i), 0.0f}, Velocity{}));
+    }
+    ids.push_back(source.createEntity<mortal>(Position{}, Velocity{}, Lifetime{1.0f}));
+    source.destroyEntity(ids[1]); // One slot on the free list
+
+    snapshotWriter out;
+    CHECK(source.saveSnapshot(out));
+    const std::vector<std::byte> bytes = out.take();
+
+    // Directory layout: header, record count, free head/tail, live count,
+    // then the records at the next aligned offset.
+    constexpr size_t FREE_HEAD = sizeof(snapshotHeader) + sizeof(uint64_t);
+    constexpr size_t RECORDS = SNAPSHOT_ALIGNMENT;
+    auto patched = [&bytes](size_t offset, auto value) {
+        std::vector<std::byte> copy = bytes;
+        std::memcpy(copy.data() + offset, &value, sizeof(value));
+        return copy;
+    };
+    auto recordField = [](size_t index, size_t field) {
+        return RECORDS + index * sizeof(EntityRecord) + field;
+    };
+
+    world target(1);
+    CHECK(target.loadSnapshot(bytes));
+    CHECK(target.entityCount() == 4);
+    CHECK(target.getComponent<Position>(ids[3]).x == 3.0f);
+
+    const std::vector<std::byte> broken[] = {
+        patched(recordField(0, offsetof(EntityRecord, localId)), archetypeid(1000)),         // Row out of range
+        patched(recordField(2, offsetof(EntityRecord, localId)), archetypeid(0)),            // Row owned by another entity
+        patched(recordField(3, offsetof(EntityRecord, archetypeIndex)), archetypeindex(7)),  // No such archetype
+        patched(recordField(4, offsetof(EntityRecord, archetypeIndex)), archetypeindex(0)),  // Wrong archetype
+        patched(recordField(1, offsetof(EntityRecord, archetypeIndex)), archetypeindex(0)),  // Free slot marked live
+        patched(FREE_HEAD, entityid(0)),                                                     // Free list through a live slot
+        patched(FREE_HEAD, entityid(NULL_ID)),                                               // Free slot left off the list
+        patched(FREE_HEAD + sizeof(entityid), entityid(3)),                                  // Wrong tail
+    };
+    for (const std::vector<std::byte>& snapshot : broken) {
+        CHECK(target.loadSnapshot(bytes));
+        CHECK(!target.loadSnapshot(snapshot));
+        CHECK(target.entityCount() == 0);
+        CHECK(target.queryCount<query<Position>>() == 0);
+        CHECK(!target.isValid(ids[0]));
+    }
+}
+
+// Counts the rows whose Position or Velocity changed since its previous run.
+template<typename ECS>
+class ChangeCounter : public SystemCRTP<ChangeCounter<ECS>, ECS, reads<Position, Velocity>> {
+public:
+    explicit ChangeCounter(ECS& world) : SystemCRTP<ChangeCounter<ECS>, ECS, reads<Position, Velocity>>(world) {}
+
+    void tick(float) override {
+        positions = 0;
+        velocities = 0;
+        this->_world.template forEachWithComponents<const Position, changed<Position>>([this](const Position&) {
+            ++positions;
+        });
+        this->_world.template forEachWithComponents<const Velocity, changed<Velocity>>([this](const Velocity&) {
+            ++velocities;
+        });
+    }
+
+    size_t positions = 0;
+    size_t velocities = 0;
+};
+
+// Checkpoints share the blocks that did not change since the previous one,
+// and restoring copies back only the blocks written since the checkpoint.
+void testCheckpointCopyOnWrite() {
+    using world = ecs<moving>;
+    constexpr size_t BLOCK = moving::TRACK_ROWS;
+    constexpr size_t ROWS = 8 * BLOCK;
+    world w(1);
+    std::vector<entityid> ids(ROWS);
+    w.createEntities<moving>(ROWS, [](size_t i, Position& pos, Velocity& vel) {
+        pos = Position{float(i), 0.0f};
+        vel = Velocity{1.0f, 0.0f};
+    }, ids);
+    auto& counter = w.registerSystem<ChangeCounter>();
+    w.step(0.0f);
+    w.step(0.0f);
+    CHECK(counter.positions == 0);
+
+    auto allocated = [&w] { return w.memoryUsage().bytesAllocated; };
+    uint64_t before = allocated();
+    checkpointid full = w.checkpoint();
+    uint64_t fullBytes = allocated() - before;
+    CHECK(fullBytes >= ROWS * (sizeof(entityid) + sizeof(Position) + sizeof(Velocity)));
+
+    // Nothing changed: every block is shared, only the block lists are new.
+    before = allocated();
+    CHECK(w.checkpoint() != NULL_CHECKPOINT);
+    CHECK(allocated() - before < BLOCK * sizeof(Position));
+
+    // One Position written: that block of that column is copied, nothing else.
+    w.getComponent<Position>(ids[3 * BLOCK + 5]) = Position{-1.0f, -1.0f};
+    before = allocated();
+    CHECK(w.checkpoint() != NULL_CHECKPOINT);
+    uint64_t oneBlock = allocated() - before;
+    CHECK(oneBlock >= BLOCK * sizeof(Position));
+    CHECK(oneBlock < 2 * BLOCK * sizeof(Position));
+
+    // Restoring the full checkpoint copies back only that block.
+    w.step(0.0f);
+    CHECK(counter.positions == BLOCK);
+    CHECK(w.restore(full));
+    CHECK(w.getComponent<const Position>(ids[3 * BLOCK + 5]).x == float(3 * BLOCK + 5));
+    w.step(0.0f);
+    CHECK(counter.positions == BLOCK);
+    CHECK(counter.velocities == 0);
+    size_t wrong = 0;
+    w.forEachWithComponents<const Position>([&wrong](entityid id, const Position& pos) {
+        wrong += pos.x != float(entityIndex(id)) || pos.y != 0.0f;
+    });
+    CHECK(wrong == 0);
+}
+
+// A handle created after a checkpoint is stale once the world is rolled back,
+// even when it reused a slot that the rollback frees again.
+void testCheckpointRollbackHandles() {
+    ecs<moving> world(1);
+    entityid kept = world.createEntity<moving>(Position{1.0f, 0.0f}, Velocity{});
+    entityid freed = world.createEntity<moving>(Position{2.0f, 0.0f}, Velocity{});
+    world.destroyEntity(freed);
+    checkpointid before = world.checkpoint();
+
+    entityid reused = world.createEntity<moving>(Position{3.0f, 0.0f}, Velocity{});
+    entityid grown = world.createEntity<moving>(Position{4.0f, 0.0f}, Velocity{});
+    CHECK(entityIndex(reused) == entityIndex(freed));
+    CHECK(world.restore(before));
+
+    CHECK(world.entityCount() == 1);
+    CHECK(world.isValid(kept));
+    CHECK(!world.isValid(reused));
+    CHECK(!world.isValid(grown));
+    world.destroyEntity(reused);
+    world.destroyEntity(grown);
+    CHECK(world.entityCount() == 1);
+    CHECK(world.isValid(kept));
+    CHECK(world.getComponent<const Position>(kept).x == 1.0f);
+
+    // The free list is intact: the freed slot is handed out once, then the directory grows.
+    entityid again = world.createEntity<moving>(Position{}, Velocity{});
+    entityid next = world.createEntity<moving>(Position{}, Velocity{});
+    CHECK(entityIndex(again) == entityIndex(freed));
+    CHECK(entityIndex(next) != entityIndex(freed));
+    CHECK(world.entityCount() == 3);
+}
+
+// nearest() agrees with a brute-force search for points inside, next to and
+// far outside the occupied grid, and far points cost a linear pass at most.
+void testNearest() {
+    using box = archetype<Position, AABB>;
+    ecs<box> world(1);
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> coord(0.0f, 100.0f);
+    std::vector<std::pair<entityid, AABB>> colliders;
+    for (int i = 0; i < 1000; ++i) {
+        Position pos{coord(rng), coord(rng)};
+        AABB extent{-0.5f, 0.5f, -0.5f, 0.5f};
+        colliders.emplace_back(world.createEntity<box>(pos, extent), worldBounds(pos, extent));
+    }
+    auto& spatial = world.registerSystem<SpatialSystem>();
+    world.step(0.0f);
+
+    const std::pair<float, float> points[] = {
+        {50.0f, 50.0f}, {0.0f, 0.0f}, {-3.0f, 50.0f}, {120.0f, 130.0f}, {1000.0f, 1000.0f}, {10000.0f, 10000.0f}, {-1e9f, 5.0f}};
+    for (auto [x, y] : points) {
+        for (size_t k : {size_t(1), size_t(3), size_t(20)}) {
+            std::vector<entityid> found;
+            spatial.nearest(x, y, k, found);
+
+            std::vector<float> expected;
+            for (const auto& collider : colliders) {
+                expected.push_back(distanceSq(collider.second, x, y));
+            }
+            std::sort(expected.begin(), expected.end());
+            CHECK(found.size() == k);
+            for (size_t i = 0; i < found.size() && i < k; ++i) {
+                auto it = std::find_if(colliders.begin(), colliders.end(), [&](const auto& c) { return c.first == found[i]; });
+                CHECK(it != colliders.end() && distanceSq(it->second, x, y) == expected[i]);
+            }
+        }
+    }
+
+    // Used to walk every ring out from the point: seconds for this one.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<entityid> far;
+    for (int i = 0; i < 100; ++i) {
+        spatial.nearest(1e6f, 1e6f, 3, far);
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+}
+
+// Moved and resized colliders are updated in the grid in place: queries and
+// pairs match a brute-force pass over the world after every step, and only
+// added or removed colliders rebuild the grid (other entities never do).
+void testSpatialIncremental() {
+    using box = archetype<Position, AABB>;
+    using ball = archetype<Position, Circle>;
+    using world = ecs<box, ball, moving>;
+    world w(4);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> coord(0.0f, 200.0f);
+    std::uniform_real_distribution<float> nudge(-1.5f, 1.5f);
+    std::uniform_int_distribution<size_t> pick(0, 3999);
+    std::vector<entityid> ids;
+    for (int i = 0; i < 2000; ++i) {
+        ids.push_back(w.createEntity<box>(Position{coord(rng), coord(rng)}, AABB{-0.5f, 0.5f, -0.5f, 0.5f}));
+        ids.push_back(w.createEntity<ball>(Position{coord(rng), coord(rng)}, Circle{0.5f, 0.0f, 0.0f}));
+    }
+    auto& spatial = w.registerSystem<SpatialSystem>();
+    w.step(0.0f);
+    CHECK(spatial.rebuilds() == 1);
+
+    auto boundsOf = [&w](entityid id) {
+        const Position& pos = w.getComponent<const Position>(id);
+        if (const AABB* shape = w.tryGetComponent<const AABB>(id)) {
+            return worldBounds(pos, *shape);
+        }
+        return worldBounds(pos, *w.tryGetComponent<const Circle>(id));
+    };
+    auto matchesWorld = [&](bool pairs) {
+        std::vector<AABB> bounds;
+        for (entityid id : ids) {
+            bounds.push_back(boundsOf(id));
+        }
+        size_t wrong = 0;
+        for (int q = 0; q < 4; ++q) {
+            float x = coord(rng), y = coord(rng);
+            AABB area{x, x + 15.0f, y, y + 15.0f};
+            std::vector<entityid> found, expected;
+            spatial.queryBox(area, found);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (overlaps(bounds[i], area)) {
+                    expected.push_back(ids[i]);
+                }
+            }
+            std::sort(found.begin(), found.end());
+            std::sort(expected.begin(), expected.end());
+            wrong += found != expected;
+
+            std::vector<entityid> near;
+            spatial.nearest(x, y, 4, near);
+            std::vector<float> distances;
+            for (const AABB& b : bounds) {
+                distances.push_back(distanceSq(b, x, y));
+            }
+            std::partial_sort(distances.begin(), distances.begin() + 4, distances.end());
+            for (size_t i = 0; i < near.size(); ++i) {
+                wrong += distanceSq(boundsOf(near[i]), x, y) != distances[i];
+            }
+            wrong += near.size() != 4;
+        }
+        if (pairs) {
+            std::vector<spatialPair> found;
+            spatial.overlappingPairs(found);
+            std::vector<std::pair<entityid, entityid>> got, expected;
+            for (const spatialPair& p : found) {
+                got.emplace_back(std::min(p.a, p.b), std::max(p.a, p.b));
+            }
+            for (size_t i = 0; i < ids.size(); ++i) {
+                for (size_t j = i + 1; j < ids.size(); ++j) {
+                    if (overlaps(bounds[i], bounds[j])) {
+                        expected.emplace_back(std::min(ids[i], ids[j]), std::max(ids[i], ids[j]));
+                    }
+                }
+            }
+            std::sort(got.begin(), got.end());
+            std::sort(expected.begin(), expected.end());
+            wrong += got != expected;
+        }
+        return wrong == 0;
+    };
+
+    for (int step = 0; step < 30; ++step) {
+        for (int i = 0; i < 800; ++i) {
+            Position& pos = w.getComponent<Position>(ids[pick(rng)]);
+            pos = Position{pos.x + nudge(rng), pos.y + nudge(rng)};
+        }
+        if (step % 5 == 0) {
+            for (int i = 0; i < 50; ++i) {
+                w.getComponent<Position>(ids[pick(rng)]) = Position{coord(rng) * 3.0f, -coord(rng)};
+            }
+        }
+        if (step == 7) {
+            w.getComponent<Circle>(ids[1]).radius = 0.25f;
+        }
+        w.createEntities<moving>(100, [](size_t, Position&, Velocity&) {}); // Not colliders
+        w.step(0.0f);
+        CHECK(matchesWorld(step % 10 == 0));
+    }
+    CHECK(spatial.rebuilds() == 1);
+    CHECK(spatial.size() == ids.size());
+
+    // A collider that outgrows the cells, then one that leaves, rebuild.
+    w.getComponent<AABB>(ids[0]) = AABB{-4.0f, 4.0f, -4.0f, 4.0f};
+    w.step(0.0f);
+    CHECK(spatial.rebuilds() == 2);
+    CHECK(matchesWorld(true));
+    w.destroyEntity(ids.back());
+    ids.pop_back();
+    w.step(0.0f);
+    CHECK(spatial.rebuilds() == 3);
+    CHECK(spatial.size() == ids.size());
+    CHECK(matchesWorld(false));
+}
+
+// Records the tick and tickBatch calls it receives.
+template<typename ECS>
+class TickRecorder : public SystemCRTP<TickRecorder<ECS>, ECS, reads<Position>> {
+public:
+    TickRecorder(ECS& world, uint32_t tickrate) : SystemCRTP<TickRecorder<ECS>, ECS, reads<Position>>(world, tickrate) {}
+
+    void tick(float dt) override {
+        ticks.push_back(dt);
+    }
+
+    void tickBatch(float dt, uint32_t substeps) override {
+        batches.emplace_back(dt, substeps);
+    }
+
+    std::vector<float> ticks;
+    std::vector<std::pair<float, uint32_t>> batches;
+};
+
+// Like TickRecorder, but without a fused tickBatch.
+template<typename ECS>
+class PlainTicker : public SystemCRTP<PlainTicker<ECS>, ECS, reads<Position>> {
+public:
+    PlainTicker(ECS& world, uint32_t tickrate) : SystemCRTP<PlainTicker<ECS>, ECS, reads<Position>>(world, tickrate) {}
+
+    void tick(float dt) override {
+        ticks.push_back(dt);
+    }
+
+    std::vector<float> ticks;
+};
+
+// Fixed-rate systems get the ticks due as one tickBatch call, capped by the
+// default policy (8 substeps, at most one tick carried over); alpha() is the
+// fraction of a tick left over.
+void testSubsteps() {
+    ecs<moving> world(1);
+    constexpr float TICK = 1.0f / 8.0f; // Exact in binary
+    auto& fused = world.registerSystem<TickRecorder>(8u);
+    auto& plain = world.registerSystem<PlainTicker>(8u);
+    CHECK(fused.getSubstepPolicy().maxSubsteps == 8);
+    CHECK(fused.getSubstepPolicy().maxCarryTicks == 1.0f);
+
+    world.step(3 * TICK);
+    CHECK(fused.batches.size() == 1 && fused.batches[0] == std::make_pair(TICK, 3u));
+    CHECK(fused.ticks.empty());
+    CHECK(plain.ticks == std::vector<float>(3, TICK));
+    CHECK(fused.alpha() == 0.0f);
+
+    world.step(TICK / 2);
+    CHECK(fused.batches.size() == 1); // Nothing due
+    CHECK(fused.alpha() == 0.5f);
+
+    // A long frame: 8 substeps, then only one tick of backlog is kept.
+    world.step(10.0f);
+    CHECK(fused.batches.size() == 2 && fused.batches[1].second == 8);
+    CHECK(plain.ticks.size() == 11);
+    CHECK(fused.alpha() == 1.0f);
+    world.step(0.0f);
+    CHECK(fused.batches.size() == 3 && fused.batches[2].second == 1);
+    CHECK(fused.alpha() == 0.0f);
+
+    // No cap: everything due runs in one batch.
+    fused.setSubstepPolicy(substepPolicy{0, 1.0f});
+    world.step(2.0f);
+    CHECK(fused.batches.size() == 4 && fused.batches[3].second == 16);
+}
+
+// A compile-time pipeline leaves the world exactly as step() with the same
+// systems registered at runtime, and still runs registered systems after it.
+void testPipelineMatchesStep() {
+    using world = ecs<moving, mortal>;
+    world dynamic(4);
+    world fixed(4);
+    for (world* w : {&dynamic, &fixed}) {
+        w->createEntities<moving>(5000, [](size_t i, Position& pos, Velocity& vel) {
+            pos = Position{float(i), 0.0f};
+            vel = Velocity{float(i % 7), 1.0f};
+        });
+        for (int i = 0; i < 1000; ++i) {
+            w->createEntity<mortal>(Position{float(i), 1.0f}, Velocity{1.0f, 0.0f}, Lifetime{float(i % 50) / 25.0f});
+        }
+    }
+    dynamic.registerSystem<PhysicsSystem>();
+    dynamic.registerSystem<LifetimeSystem>();
+    auto& dynamicTicks = dynamic.registerSystem<PlainTicker>(30u);
+    world::pipeline<PhysicsSystem, LifetimeSystem> systems(fixed);
+    auto& fixedTicks = fixed.registerSystem<PlainTicker>(30u);
+
+    for (int i = 0; i < 90; ++i) {
+        float dt = (i % 3 + 1) / 60.0f;
+        dynamic.step(dt);
+        systems.step(dt);
+    }
+    CHECK(fixedTicks.ticks == dynamicTicks.ticks);
+    CHECK(systems.get<LifetimeSystem>().now() > 0);
+    CHECK(fixed.entityCount() == dynamic.entityCount());
+    CHECK(fixed.queryCount<query<Lifetime>>() < 1000); // Some expired
+    size_t wrong = 0;
+    dynamic.forEachWithComponents<const Position, const Velocity>([&](entityid id, const Position& pos, const Velocity& vel) {
+        if (!fixed.isValid(id)) {
+            ++wrong;
+            return;
+        }
+        const Position& p = fixed.getComponent<const Position>(id);
+        const Velocity& v = fixed.getComponent<const Velocity>(id);
+        wrong += p.x != pos.x || p.y != pos.y || v.dx != vel.dx || v.dy != vel.dy;
+    });
+    CHECK(wrong == 0);
+}
+
+// Handles on either side of directory page boundaries stay valid, freed
+// slots on any page are reused oldest first with the next generation, and
+// the directory only grows once the free list is empty.
+void testDirectoryPages() {
+    ecs<moving> world(1);
+    constexpr size_t COUNT = 3 * DIRECTORY_PAGE_SLOTS + 10;
+    std::vector<entityid> ids;
+    for (size_t i = 0; i < COUNT; ++i) {
+        ids.push_back(world.createEntity<moving>(Position{float(i), 0.0f}, Velocity{}));
+    }
+    CHECK(entityIndex(ids.back()) == COUNT - 1);
+
+    const size_t freed[] = {3000, 5, DIRECTORY_PAGE_SLOTS, 2 * DIRECTORY_PAGE_SLOTS - 1, DIRECTORY_PAGE_SLOTS - 1,
+                            2 * DIRECTORY_PAGE_SLOTS, 3 * DIRECTORY_PAGE_SLOTS};
+    for (size_t index : freed) {
+        world.destroyEntity(ids[index]);
+    }
+    CHECK(world.entityCount() == COUNT - std::size(freed));
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < COUNT; ++i) {
+        bool alive = std::find(std::begin(freed), std::end(freed), i) == std::end(freed);
+        wrong += world.isValid(ids[i]) != alive;
+        if (alive) {
+            wrong += world.getComponent<const Position>(ids[i]).x != float(i);
+        }
+    }
+    CHECK(wrong == 0);
+
+    for (size_t index : freed) {
+        entityid id = world.createEntity<moving>(Position{-1.0f, 0.0f}, Velocity{});
+        CHECK(entityIndex(id) == index);
+        CHECK(entityGeneration(id) == entityGeneration(ids[index]) + 1);
+        CHECK(!world.isValid(ids[index]));
+    }
+    CHECK(entityIndex(world.createEntity<moving>(Position{}, Velocity{})) == COUNT);
+    CHECK(world.entityCount() == COUNT + 1);
+}
+
+// A Lifetime that comes back already expired, from a snapshot written by an
+// earlier world or from a checkpoint taken before it ran out, expires on the
+// next tick instead of lingering.
+void testLifetimeRestoredPastDue() {
+    using world = ecs<moving, mortal>;
+    constexpr float DT = 1.0f / 60.0f;
+
+    // Snapshot: written one tick into a 1 s lifetime, loaded 200 ticks later.
+    world source(1);
+    source.registerSystem<LifetimeSystem>();
+    source.createEntity<mortal>(Position{}, Velocity{}, Lifetime{1.0f});
+    source.step(DT);
+    snapshotWriter out;
+    CHECK(source.saveSnapshot(out));
+
+    world loaded(1);
+    auto& lifetimes = loaded.registerSystem<LifetimeSystem>();
+    for (int i = 0; i < 200; ++i) {
+        loaded.step(DT);
+    }
+    CHECK(loaded.loadSnapshot(out.take()));
+    CHECK(loaded.queryCount<query<Lifetime>>() == 1);
+    for (int i = 0; i < 3; ++i) {
+        loaded.step(DT);
+    }
+    CHECK(loaded.queryCount<query<Lifetime>>() == 0);
+    CHECK(lifetimes.pending() == 0);
+
+    // Checkpoint: taken before the expiry, restored after it.
+    world rolled(1);
+    rolled.registerSystem<LifetimeSystem>();
+    rolled.createEntity<mortal>(Position{}, Velocity{}, Lifetime{0.5f});
+    rolled.step(DT);
+    checkpointid before = rolled.checkpoint();
+    for (int i = 0; i < 60; ++i) {
+        rolled.step(DT);
+    }
+    CHECK(rolled.queryCount<query<Lifetime>>() == 0);
+    CHECK(rolled.restore(before));
+    CHECK(rolled.queryCount<query<Lifetime>>() == 1);
+    for (int i = 0; i < 3; ++i) {
+        rolled.step(DT);
+    }
+    CHECK(rolled.queryCount<query<Lifetime>>() == 0);
+
+    // Without a fixed rate nothing could expire on time: rejected in every build.
+    world unticked(1);
+    bool threw = false;
+    try {
+        unticked.registerSystem<LifetimeSystem>(0u);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+// The extracted array holds exactly the world's drawables, with their current
+// position and key, sorted by key, and batch(key) is each key's whole run.
+void checkExtract(const RenderExtractSystem<ecs<moving, colored>>& extract, ecs<moving, colored>& world) {
+    std::vector<renderInstance> expected;
+    world.forEachWithComponents<const Position, const EColor>([&](entityid id, const Position& pos, const EColor& color) {
+        expected.push_back(renderInstance{pos.x, pos.y, uint32_t(color.col), id});
+    });
+    auto byId = [](const renderInstance& a, const renderInstance& b) { return a.id < b.id; };
+    std::sort(expected.begin(), expected.end(), byId);
+
+    std::span<const renderInstance> all = extract.instances();
+    CHECK(all.size() == expected.size());
+    CHECK(std::is_sorted(all.begin(), all.end(), [](const renderInstance& a, const renderInstance& b) { return a.key < b.key; }));
+
+    std::vector<renderInstance> actual(all.begin(), all.end());
+    std::sort(actual.begin(), actual.end(), byId);
+    size_t mismatched = 0;
+    for (size_t i = 0; i < std::min(actual.size(), expected.size()); ++i) {
+        const renderInstance& a = actual[i];
+        const renderInstance& e = expected[i];
+        mismatched += a.id != e.id || a.key != e.key || a.x != e.x || a.y != e.y;
+    }
+    CHECK(mismatched == 0);
+
+    size_t batched = 0;
+    for (size_t i = 0; i < all.size(); i += extract.batch(all[i].key).size()) {
+        std::span<const renderInstance> run = extract.batch(all[i].key);
+        CHECK(run.data() == all.data() + i);
+        CHECK(!run.empty() && std::all_of(run.begin(), run.end(), [&](const renderInstance& r) { return r.key == all[i].key; }));
+        size_t count = size_t(std::count_if(expected.begin(), expected.end(), [&](const renderInstance& r) { return r.key == all[i].key; }));
+        CHECK(run.size() == count);
+        batched += run.size();
+        if (run.empty()) {
+            break;
+        }
+    }
+    CHECK(batched == all.size());
+    CHECK(extract.batch(4095).empty());
+}
+
+// Render extraction rebuilds when drawables come, go or change key, patches
+// positions in place when only they changed, and keeps the array otherwise.
+void testRenderExtract() {
+    using world = ecs<moving, colored>;
+    world w(4);
+    auto& extract = w.registerSystem<RenderExtractSystem>();
+
+    // Enough rows for several sort ranges, plus entities that are not drawn.
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> keys(0, 11);
+    std::vector<entityid> ids;
+    for (size_t i = 0; i < 40000; ++i) {
+        ids.push_back(w.createEntity<colored>(Position{float(i), -float(i)}, EColor{keys(rng)}));
+    }
+    w.createEntities<moving>(1000, [](size_t, Position&, Velocity&) {});
+
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 1);
+    checkExtract(extract, w);
+
+    uint64_t version = extract.version();
+    w.step(0.0f);
+    CHECK(extract.version() == version);
+    CHECK(extract.rebuilds() == 1);
+
+    // Position writes: patched, not rebuilt.
+    for (size_t i = 0; i < ids.size(); i += 7) {
+        w.getComponent<Position>(ids[i]) = Position{0.5f * float(i), 3.0f};
+    }
+    w.step(0.0f);
+    CHECK(extract.version() == version + 1);
+    CHECK(extract.rebuilds() == 1);
+    checkExtract(extract, w);
+
+    // Destroyed drawables.
+    for (size_t i = 0; i < ids.size(); i += 5) {
+        w.destroyEntity(ids[i]);
+    }
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 2);
+    checkExtract(extract, w);
+
+    // New drawables.
+    for (size_t i = 0; i < 100; ++i) {
+        w.createEntity<colored>(Position{1.0f, float(i)}, EColor{keys(rng)});
+    }
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 3);
+    checkExtract(extract, w);
+
+    // Key changes, one past the dense counting sort range.
+    w.getComponent<EColor>(ids[1]).col = 3;
+    w.getComponent<EColor>(ids[2]).col = 5000;
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 4);
+    CHECK(extract.batch(5000).size() == 1);
+    checkExtract(extract, w);
+
+    // Back to dense keys, then a patch on top of the rebuilt slot map.
+    w.getComponent<EColor>(ids[2]).col = 1;
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 5);
+    w.getComponent<Position>(ids[3]) = Position{-1.0f, -1.0f};
+    w.step(0.0f);
+    CHECK(extract.rebuilds() == 5);
+    checkExtract(extract, w);
+}
+
+struct stamped {
+    uint32_t value;
+};
+
+// Batches sent from several threads past the channel's capacity all come
+// back, exactly once, after the swap; the channel then holds the peak.
+void testEventSpanOverflow() {
+    ecs<moving> world(1);
+    constexpr uint32_t THREADS = 8;
+    constexpr uint32_t BATCHES = 50;
+    constexpr uint32_t BATCH = 100;
+    auto& channel = world.events<stamped>();
+    CHECK(channel.capacity() < THREADS * BATCHES * BATCH);
+
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::thread> senders;
+        for (uint32_t t = 0; t < THREADS; ++t) {
+            senders.emplace_back([&channel, t] {
+                std::vector<stamped> batch(BATCH);
+                for (uint32_t b = 0; b < BATCHES; ++b) {
+                    for (uint32_t i = 0; i < BATCH; ++i) {
+                        batch[i] = stamped{(t * BATCHES + b) * BATCH + i};
+                    }
+                    channel.send(std::span<const stamped>(batch));
+                }
+            });
+        }
+        for (std::thread& sender : senders) {
+            sender.join();
+        }
+        world.step(0.0f);
+
+        std::vector<uint32_t> seen;
+        for (const stamped& e : channel.read()) {
+            seen.push_back(e.value);
+        }
+        std::sort(seen.begin(), seen.end());
+        CHECK(seen.size() == THREADS * BATCHES * BATCH);
+        bool exact = true;
+        for (size_t i = 0; i < seen.size(); ++i) {
+            exact = exact && seen[i] == i;
+        }
+        CHECK(exact);
+    }
+    CHECK(channel.capacity() >= THREADS * BATCHES * BATCH);
+}
+
+template<size_t N>
+struct numbered {
+    uint32_t value;
+};
+
+struct overflowEvent {
+    uint32_t value;
+};
+
+// Event ids are shared by every world and run past the first table page; the
+// table grows a page at a time and refuses ids past MAX_EVENT_TYPES.
+void testEventTablePages() {
+    using world = ecs<moving>;
+    world a(1);
+    world b(1);
+    constexpr size_t TYPES = EVENT_PAGE_SLOTS + 8;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (a.events<numbered<I>>().send(numbered<I>{uint32_t(I)}), ...);
+        (b.events<numbered<I>>().send(numbered<I>{uint32_t(I) + 1000}), ...);
+    }(std::make_index_sequence<TYPES>{});
+    a.step(0.0f);
+    b.step(0.0f);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        CHECK(((eventId<numbered<I>>() == eventId<numbered<I>>()) && ...));
+        CHECK(((a.events<numbered<I>>().read().size() == 1 && a.events<numbered<I>>().read()[0].value == I) && ...));
+        CHECK(((b.events<numbered<I>>().read().size() == 1 && b.events<numbered<I>>().read()[0].value == I + 1000) && ...));
+    }(std::make_index_sequence<TYPES>{});
+    CHECK(eventId<numbered<TYPES - 1>>() >= EVENT_PAGE_SLOTS);
+
+    // Pretend the program already used every id.
+    uint32_t next = nextEventId.exchange(uint32_t(MAX_EVENT_TYPES));
+    bool threw = false;
+    try {
+        a.events<overflowEvent>();
+    } catch (const std::length_error&) {
+        threw = true;
+    }
+    nextEventId.store(next);
+    CHECK(threw);
+}
+
+// The stepper's frame is the world after its last synced step, and it does
+// not change while the next step simulates on the pool.
+void testOverlappedStepper() {
+    using world = ecs<moving>;
+    world overlapped(4);
+    world reference(1);
+    for (world* w : {&overlapped, &reference}) {
+        w->createEntities<moving>(20000, [](size_t i, Position& pos, Velocity& vel) {
+            pos = Position{float(i), 0.0f};
+            vel = Velocity{1.0f, float(i % 5)};
+        });
+        w->registerSystem<PhysicsSystem>();
+    }
+
+    constexpr float DT = 1.0f / 60.0f;
+    overlappedStepper<world, Position> stepper(overlapped);
+    size_t changedDuringStep = 0;
+    size_t wrong = 0;
+    uint64_t steps = 0;
+    for (int round = 0; round < 10; ++round) {
+        stepper.launch(DT);
+        const auto& frame = stepper.sync();
+        reference.step(DT);
+        CHECK(frame.frame() == ++steps);
+        CHECK(frame.size() == reference.entityCount());
+        std::vector<Position> expected(reference.entityCount());
+        reference.forEachWithComponents<const Position>([&](entityid id, const Position& pos) {
+            expected[entityIndex(id)] = pos;
+        });
+        for (size_t i = 0; i < frame.size(); ++i) {
+            const Position& p = frame.column<Position>()[i];
+            const Position& e = expected[entityIndex(frame.ids()[i])];
+            wrong += p.x != e.x || p.y != e.y;
+        }
+
+        // Draw this frame while the next step runs; then the world is ahead.
+        std::vector<Position> copy(frame.column<Position>().begin(), frame.column<Position>().end());
+        stepper.launch(DT);
+        for (int pass = 0; pass < 3; ++pass) {
+            for (size_t i = 0; i < copy.size(); ++i) {
+                changedDuringStep += frame.column<Position>()[i].x != copy[i].x || frame.column<Position>()[i].y != copy[i].y;
+            }
+        }
+        CHECK(stepper.sync().frame() == ++steps);
+        reference.step(DT);
+    }
+    CHECK(wrong == 0);
+    CHECK(changedDuringStep == 0);
+    CHECK(!stepper.inFlight());
+}
+
+struct testCase {
+    const char* name;
+    void (*run)();
+};
+
+constexpr testCase TESTS[] = {
+    {"parallel_for_each", testParallelForEach},
+    {"system_schedule", testSystemSchedule},
+    {"command_buffers", testCommandBuffers},
+    {"chunked_addresses", testChunkedAddresses},
+    {"missing_edge", testMissingEdge},
+    {"generation_wrap", testGenerationWrap},
+    {"bulk_create_destroy", testBulkCreateDestroy},
+    {"chunk_spans", testChunkSpans},
+    {"soa_physics", testSoaPhysicsMatchesAos},
+    {"parallel_get_tick", testParallelGetComponentTick},
+    {"snapshot_validation", testSnapshotValidation},
+    {"checkpoint_cow", testCheckpointCopyOnWrite},
+    {"checkpoint_handles", testCheckpointRollbackHandles},
+    {"nearest", testNearest},
+    {"spatial_incremental", testSpatialIncremental},
+    {"substeps", testSubsteps},
+    {"pipeline_step", testPipelineMatchesStep},
+    {"directory_pages", testDirectoryPages},
+    {"lifetime_past_due", testLifetimeRestoredPastDue},
+    {"event_span_overflow", testEventSpanOverflow},
+    {"event_table_pages", testEventTablePages},
+    {"render_extract", testRenderExtract},
+    {"overlapped_stepper", testOverlappedStepper},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t ran = 0;
+    for (const testCase& test : TESTS) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], test.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        int before = g_failures;
+        test.run();
+        std::fprintf(stderr, "%-20s %s\n", test.name, g_failures == before ? "ok" : "FAILED");
+        ++ran;
+    }
+    if (ran == 0) {
+        std::fprintf(stderr, "no test matched\n");
+        return 1;
+    }
+    return g_failures == 0 ? 0 : 1;
+}